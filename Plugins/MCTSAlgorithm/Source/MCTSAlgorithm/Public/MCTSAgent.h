@@ -4,8 +4,13 @@
 #include <vector>
 #include <map>
 #include <cmath>
+#include <atomic>
 #include "Math/Vector2D.h"
 #include "Math/IntPoint.h"
+#include "Async/ParallelFor.h"
+#include "MCTSNodePool.h"
+#include "MCTSRandom.h"
+#include "MCTSTranspositionTable.h"
 #include "MCTSAgent.generated.h"
 
 // Structs
@@ -131,7 +136,463 @@ private:
     }
 };
 
+// Compact integer key for a move, used by the search tree instead of FMCTSMove::ToString().
+// Only the first target is kept, which is all EnumerateMoves ever produces.
+// Layout (low to high): player (1 bit), move index + 8 (8 bits, so system moves down to -8 fit),
+// selector (4 bits), target cell x*3+y (4 bits, 15 = no target), cost (4 bits).
+struct FMCTSMoveId {
+    static constexpr uint32 NoTargetCell = 15;
+
+    FMCTSMoveId() : packed(0) {}
+    explicit FMCTSMoveId(uint32 _packed) : packed(_packed) {}
+
+    static FMCTSMoveId Make(int32 playerIndex, int32 moveIndex, int32 selectorIndex, uint32 cell, int32 cost) {
+        return FMCTSMoveId(
+            (static_cast<uint32>(playerIndex) & 0x1)
+            | ((static_cast<uint32>(moveIndex + 8) & 0xFF) << 1)
+            | ((static_cast<uint32>(selectorIndex) & 0xF) << 9)
+            | ((cell & 0xF) << 13)
+            | ((static_cast<uint32>(cost) & 0xF) << 17));
+    }
+
+    static FMCTSMoveId EndTurn(int32 playerIndex) {
+        return Make(playerIndex, -1, 0, NoTargetCell, 0);
+    }
+
+    static FMCTSMoveId FromMove(const FMCTSMove& move) {
+        uint32 cell = NoTargetCell;
+        int32 selector = 0;
+        if (move.targets.Num() > 0) {
+            cell = static_cast<uint32>(move.targets[0].target.X) * 3 + static_cast<uint32>(move.targets[0].target.Y);
+            selector = move.targets[0].selectorIndex;
+        }
+        return Make(move.playerIndex, move.moveIndex, selector, cell, move.cost);
+    }
+
+    int32 GetPlayerIndex() const { return packed & 0x1; }
+    int32 GetMoveIndex() const { return static_cast<int32>((packed >> 1) & 0xFF) - 8; }
+    int32 GetSelectorIndex() const { return (packed >> 9) & 0xF; }
+    int32 GetTargetCell() const { return (packed >> 13) & 0xF; }
+    int32 GetCost() const { return (packed >> 17) & 0xF; }
+
+    bool IsEndTurn() const { return GetMoveIndex() == -1; }
+    bool HasTarget() const { return GetTargetCell() != NoTargetCell; }
+
+    FMCTSMove ToMove() const {
+        FMCTSMove move = FMCTSMove(GetPlayerIndex());
+        move.moveIndex = GetMoveIndex();
+        move.cost = GetCost();
+        if (HasTarget()) {
+            FMCTSMoveTargetingData targetingData = FMCTSMoveTargetingData(GetSelectorIndex(), FVector2D(GetTargetCell() / 3, GetTargetCell() % 3));
+            targetingData.selectorIndex = GetSelectorIndex(); // The two-arg constructor doesn't keep the selector.
+            move.targets = { targetingData };
+        }
+        return move;
+    }
+
+    bool operator==(const FMCTSMoveId& other) const { return packed == other.packed; }
+    bool operator!=(const FMCTSMoveId& other) const { return packed != other.packed; }
+
+    uint32 packed;
+};
+
+// Enough inline room for any turn the battle can produce, so enumerating moves never touches the heap.
+typedef TArray<FMCTSMoveId, TInlineAllocator<64>> FMCTSMoveList;
+
+// The moves one player made in one turn, for RAVE. A fixed open-addressed table on the stack, so Contains is a probe
+// or two. Stops taking new moves once it's three quarters full, which only drops moves from very long turns.
+struct FMCTSMoveSet {
+    static constexpr int32 NumSlots = 64;
+    static constexpr int32 MaxMoves = NumSlots * 3 / 4;
+
+    FMCTSMoveSet() { Reset(); }
+
+    void Reset() {
+        FMemory::Memzero(slots, sizeof(slots));
+        num = 0;
+    }
+
+    void Add(FMCTSMoveId move) {
+        const uint32 key = move.packed + 1; // 0 marks an empty slot.
+        for (uint32 slot = Hash(key);; slot = (slot + 1) & (NumSlots - 1)) {
+            if (slots[slot] == key)
+                return;
+            if (slots[slot] == 0) {
+                if (num < MaxMoves) {
+                    slots[slot] = key;
+                    num++;
+                }
+                return;
+            }
+        }
+    }
+
+    bool Contains(FMCTSMoveId move) const {
+        const uint32 key = move.packed + 1;
+        for (uint32 slot = Hash(key);; slot = (slot + 1) & (NumSlots - 1)) {
+            if (slots[slot] == key)
+                return true;
+            if (slots[slot] == 0)
+                return false;
+        }
+    }
+
+private:
+    static uint32 Hash(uint32 key) { return (key * 0x9E3779B1u) >> 26; }
+
+    uint32 slots[NumSlots];
+    int32 num;
+};
+
+struct FMCTSSearchMonster {
+    int32 id = 0;
+    float atk = 0.0f;
+    float def = 0.0f;
+    float spd = 0.0f;
+    float temp = 0.0f;
+    float hum = 0.0f;
+    float elev = 0.0f;
+    int32 ap = 0;
+    float score = 0.0f;
+    uint8 cell = 0; // x*3+y, same as FMCTSMoveId.
+};
+
+// Statuses are kept as a bitmask for lookups plus the list FMCTSPlatformState::statuses would hold, in the order they
+// were added (duplicates included), since landing reactions fire in that order.
+struct FMCTSSearchPlatform {
+    // Past this, the list gives up repeats: only 5 statuses exist, so a full list always has one to spare.
+    static constexpr int32 MaxStatusEntries = 8;
+
+    float temp = 0.0f;
+    float hum = 0.0f;
+    float elev = 0.0f;
+    uint8 statuses = 0;      // Bit per EMCTSPlatformStatusTypes.
+    uint32 statusOrder = 0;  // The list, 4 bits per entry (status + 1), first entry in the low bits. 0 ends it.
+
+    bool HasStatus(EMCTSPlatformStatusTypes status) const { return (statuses & StatusBit(status)) != 0; }
+
+    // TArray::AddUnique.
+    void AddStatus(EMCTSPlatformStatusTypes status) {
+        if (!HasStatus(status))
+            AppendStatus(status);
+    }
+
+    // TArray::Add, so a status can be listed (and react) more than once.
+    void AppendStatus(EMCTSPlatformStatusTypes status) {
+        int32 numEntries = NumStatusEntries();
+        if (numEntries == MaxStatusEntries) {
+            if (HasStatus(status))
+                return;
+            DropFirstRepeat();
+            numEntries--;
+        }
+        statusOrder |= (static_cast<uint32>(status) + 1) << (numEntries * 4);
+        statuses |= StatusBit(status);
+    }
+
+    // TArray::Remove: every entry of the status goes, the rest keep their order.
+    void RemoveStatus(EMCTSPlatformStatusTypes status) {
+        if (!HasStatus(status))
+            return;
+        uint32 kept = 0;
+        int32 numKept = 0;
+        for (uint32 order = statusOrder; order; order >>= 4) {
+            if ((order & 0xF) != static_cast<uint32>(status) + 1)
+                kept |= (order & 0xF) << (numKept++ * 4);
+        }
+        statusOrder = kept;
+        statuses &= ~StatusBit(status);
+    }
+
+    void ClearStatuses() {
+        statuses = 0;
+        statusOrder = 0;
+    }
+
+    // Calls func(status) for each entry of the list, in order.
+    template<typename Func>
+    void ForEachStatus(Func func) const {
+        for (uint32 order = statusOrder; order; order >>= 4)
+            func(static_cast<EMCTSPlatformStatusTypes>((order & 0xF) - 1));
+    }
+
+    int32 NumStatusEntries() const { return (32 - FMath::CountLeadingZeros(statusOrder) + 3) / 4; }
+
+private:
+    void DropFirstRepeat() {
+        uint32 seen = 0;
+        for (int32 entry = 0; entry < MaxStatusEntries; entry++) {
+            const uint32 shift = entry * 4;
+            const uint32 bit = 1u << ((statusOrder >> shift) & 0xF);
+            if (seen & bit) {
+                const uint32 below = statusOrder & ((1u << shift) - 1);
+                statusOrder = below | ((statusOrder >> (shift + 4)) << shift);
+                return;
+            }
+            seen |= bit;
+        }
+    }
+
+public:
+
+    static uint8 StatusBit(EMCTSPlatformStatusTypes status) { return static_cast<uint8>(1u << static_cast<uint8>(status)); }
+};
+
+// Fixed-size copy of FMCTSGameState that the search works on. The battle is always 2 monsters on a 3x3 grid, so it
+// fits in plain arrays and copying one (every NextState and playout step) never allocates.
+// Converted to and from FMCTSGameState only where the agent talks to the game.
+struct FMCTSSearchState {
+    static constexpr int32 NumMonsters = 2;
+    static constexpr int32 NumPlatforms = 9;
+
+    int32 turnCount = 0;
+    int32 actingPlayerIndex = 0;
+    FMCTSSearchMonster monsters[NumMonsters];
+    FMCTSSearchPlatform platforms[NumPlatforms]; // Indexed by cell.
+
+    static uint8 MakeCell(int32 x, int32 y) { return static_cast<uint8>(FMath::Clamp(x, 0, 2) * 3 + FMath::Clamp(y, 0, 2)); }
+    static int32 CellX(uint8 cell) { return cell / 3; }
+    static int32 CellY(uint8 cell) { return cell % 3; }
+
+    // 9-bit boards: bit `cell` is set for each cell on the board.
+    static constexpr uint16 AllCellsMask = 0x1FF;
+    static uint16 CellBit(uint8 cell) { return static_cast<uint16>(1u << cell); }
+    uint16 OccupancyMask() const { return CellBit(monsters[0].cell) | CellBit(monsters[1].cell); }
+
+    // Positions off the board are clamped onto it first, then ones between cells are rounded to the nearest cell.
+    static uint8 CellOf(const FVector2D& position) {
+        const FVector2D onBoard = position.ClampAxes(0, 2);
+        return MakeCell(FMath::RoundToInt(onBoard.X), FMath::RoundToInt(onBoard.Y));
+    }
+    static FVector2D PositionOf(uint8 cell) { return FVector2D(CellX(cell), CellY(cell)); }
+
+    static FMCTSSearchState FromGameState(const FMCTSGameState& state) {
+        FMCTSSearchState searchState;
+        searchState.turnCount = state.turnCount;
+        searchState.actingPlayerIndex = state.actingPlayerIndex;
+
+        for (int32 m = 0; m < FMath::Min(state.monsterStates.Num(), NumMonsters); m++) {
+            const FMCTSMonsterState& monster = state.monsterStates[m];
+            FMCTSSearchMonster& out = searchState.monsters[m];
+            out.id = monster.id;
+            out.atk = monster.atk;
+            out.def = monster.def;
+            out.spd = monster.spd;
+            out.temp = monster.temp;
+            out.hum = monster.hum;
+            out.elev = monster.elev;
+            out.ap = monster.ap;
+            out.score = monster.score;
+            out.cell = CellOf(monster.position);
+        }
+
+        for (int32 p = 0; p < FMath::Min(state.platformStates.Num(), NumPlatforms); p++) {
+            const FMCTSPlatformState& platform = state.platformStates[p];
+            FMCTSSearchPlatform& out = searchState.platforms[p];
+            out.temp = platform.temp;
+            out.hum = platform.hum;
+            out.elev = platform.elev;
+            for (EMCTSPlatformStatusTypes status : platform.statuses)
+                out.AppendStatus(status);
+        }
+        return searchState;
+    }
+
+    FMCTSGameState ToGameState() const {
+        FMCTSGameState state;
+        state.turnCount = turnCount;
+        state.actingPlayerIndex = actingPlayerIndex;
+
+        state.monsterStates.SetNum(NumMonsters);
+        for (int32 m = 0; m < NumMonsters; m++) {
+            FMCTSMonsterState& out = state.monsterStates[m];
+            out.id = monsters[m].id;
+            out.atk = monsters[m].atk;
+            out.def = monsters[m].def;
+            out.spd = monsters[m].spd;
+            out.temp = monsters[m].temp;
+            out.hum = monsters[m].hum;
+            out.elev = monsters[m].elev;
+            out.ap = monsters[m].ap;
+            out.score = monsters[m].score;
+            out.position = PositionOf(monsters[m].cell);
+        }
+
+        state.platformStates.SetNum(NumPlatforms);
+        for (int32 p = 0; p < NumPlatforms; p++) {
+            FMCTSPlatformState& out = state.platformStates[p];
+            out.temp = platforms[p].temp;
+            out.hum = platforms[p].hum;
+            out.elev = platforms[p].elev;
+            platforms[p].ForEachStatus([&out](EMCTSPlatformStatusTypes status) { out.statuses.Add(status); });
+        }
+        return state;
+    }
+};
+
+// Undo log for IMCTSSearchRuleSet::ApplyMove, so a line of play can be walked down on a single state and back up again.
+// Each move saves the header and both monsters, plus each platform the first time the ruleset says it's about to
+// change it (SavePlatforms). Storage is kept between uses, so a warmed-up journal doesn't allocate, and a single move
+// fits inline, so a journal on the stack that only ever holds one doesn't either.
+struct FMCTSStateJournal {
+    void BeginMove(const FMCTSSearchState& state) {
+        FFrame& frame = frames.AddDefaulted_GetRef();
+        frame.turnCount = state.turnCount;
+        frame.actingPlayerIndex = state.actingPlayerIndex;
+        for (int32 m = 0; m < FMCTSSearchState::NumMonsters; m++)
+            frame.monsters[m] = state.monsters[m];
+        frame.savedPlatforms = 0;
+        frame.firstPlatform = platforms.Num();
+    }
+
+    // Call before changing any of the given platforms during the current move.
+    void SavePlatforms(const FMCTSSearchState& state, uint16 cells) {
+        FFrame& frame = frames.Last();
+        uint16 unsaved = cells & ~frame.savedPlatforms;
+        frame.savedPlatforms |= unsaved;
+        while (unsaved) {
+            const uint8 cell = static_cast<uint8>(FMath::CountTrailingZeros(static_cast<uint32>(unsaved)));
+            platforms.Add(TPair<uint8, FMCTSSearchPlatform>(cell, state.platforms[cell]));
+            unsaved &= unsaved - 1;
+        }
+    }
+
+    // Puts the state back as it was before the most recent BeginMove.
+    void UndoMove(FMCTSSearchState& state) {
+        const FFrame& frame = frames.Last();
+        state.turnCount = frame.turnCount;
+        state.actingPlayerIndex = frame.actingPlayerIndex;
+        for (int32 m = 0; m < FMCTSSearchState::NumMonsters; m++)
+            state.monsters[m] = frame.monsters[m];
+        for (int32 p = frame.firstPlatform; p < platforms.Num(); p++)
+            state.platforms[platforms[p].Key] = platforms[p].Value;
+
+        platforms.SetNum(frame.firstPlatform, false);
+        frames.Pop(false);
+    }
+
+    int32 NumMoves() const { return frames.Num(); }
+
+    // Board of the platforms the most recent move saved, i.e. every platform it may have changed.
+    uint16 ChangedPlatforms() const { return frames.Last().savedPlatforms; }
+
+    void Reset() {
+        frames.Reset();
+        platforms.Reset();
+    }
+
+private:
+    struct FFrame {
+        int32 turnCount;
+        int32 actingPlayerIndex;
+        FMCTSSearchMonster monsters[FMCTSSearchState::NumMonsters];
+        uint16 savedPlatforms;
+        int32 firstPlatform;
+    };
+
+    TArray<FFrame, TInlineAllocator<1>> frames;
+    TArray<TPair<uint8, FMCTSSearchPlatform>, TInlineAllocator<FMCTSSearchState::NumPlatforms>> platforms;
+};
+
+// Zobrist-style 64-bit hash of an FMCTSSearchState.
+// Each (feature, quantized value) pair maps to a pseudo-random key through SplitMix64 rather than a lookup table,
+// so float features don't need huge tables. Keys are XORed together, so a child state can be rehashed from its
+// parent by swapping out only the keys of the features that changed (see Rehash).
+// Covers turn, acting player, each monster's stats/AP/score/cell, and each platform's temp/hum/elev/status set.
+struct FMCTSStateHasher {
+    static constexpr int32 NumMonsters = FMCTSSearchState::NumMonsters;
+    static constexpr int32 NumPlatforms = FMCTSSearchState::NumPlatforms;
+    static constexpr int32 MonsterFeatures = 9;
+    static constexpr int32 PlatformFeatures = 4;
+    static constexpr int32 HeaderFeatures = 2 + NumMonsters * MonsterFeatures; // Turn, acting player and monsters.
+    static constexpr int32 NumFeatures = HeaderFeatures + NumPlatforms * PlatformFeatures;
+
+    static uint64 Hash(const FMCTSSearchState& state) {
+        uint32 features[HeaderFeatures];
+        GetHeaderFeatures(state, features);
+
+        uint64 hash = 0;
+        for (int32 f = 0; f < HeaderFeatures; f++)
+            hash ^= FeatureKey(f, features[f]);
+        for (int32 p = 0; p < NumPlatforms; p++) {
+            uint32 platformFeatures[PlatformFeatures];
+            GetPlatformFeatures(state.platforms[p], platformFeatures);
+            for (int32 f = 0; f < PlatformFeatures; f++)
+                hash ^= FeatureKey(PlatformFeature(p, f), platformFeatures[f]);
+        }
+        return hash ? hash : 1; // 0 marks an empty transposition slot.
+    }
+
+    // Hash of `to` from the hash of `from`, given every platform the move between them may have changed
+    // (FMCTSStateJournal::ChangedPlatforms). Only the header, the monsters and those platforms are looked at.
+    static uint64 Rehash(uint64 hash, const FMCTSSearchState& from, const FMCTSSearchState& to, uint16 changedPlatforms) {
+        uint32 fromFeatures[HeaderFeatures];
+        uint32 toFeatures[HeaderFeatures];
+        GetHeaderFeatures(from, fromFeatures);
+        GetHeaderFeatures(to, toFeatures);
+        for (int32 f = 0; f < HeaderFeatures; f++) {
+            if (fromFeatures[f] != toFeatures[f])
+                hash ^= FeatureKey(f, fromFeatures[f]) ^ FeatureKey(f, toFeatures[f]);
+        }
+
+        while (changedPlatforms) {
+            const int32 p = FMath::CountTrailingZeros(static_cast<uint32>(changedPlatforms));
+            changedPlatforms &= changedPlatforms - 1;
+            uint32 fromPlatform[PlatformFeatures];
+            uint32 toPlatform[PlatformFeatures];
+            GetPlatformFeatures(from.platforms[p], fromPlatform);
+            GetPlatformFeatures(to.platforms[p], toPlatform);
+            for (int32 f = 0; f < PlatformFeatures; f++) {
+                if (fromPlatform[f] != toPlatform[f])
+                    hash ^= FeatureKey(PlatformFeature(p, f), fromPlatform[f]) ^ FeatureKey(PlatformFeature(p, f), toPlatform[f]);
+            }
+        }
+        return hash ? hash : 1;
+    }
+
+private:
+    static uint64 FeatureKey(int32 feature, uint32 value) {
+        uint64 z = (static_cast<uint64>(feature) << 32 | value) + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Stats move in whole points, conditions in hundredths, so quantize a little below that.
+    static uint32 QuantizeStat(float value) { return static_cast<uint32>(FMath::RoundToInt(value * 4.0f)); }
+    static uint32 QuantizeCondition(float value) { return static_cast<uint32>(FMath::RoundToInt(value * 1024.0f)); }
+
+    static int32 PlatformFeature(int32 platform, int32 feature) { return HeaderFeatures + platform * PlatformFeatures + feature; }
+
+    static void GetHeaderFeatures(const FMCTSSearchState& state, uint32 (&features)[HeaderFeatures]) {
+        features[0] = static_cast<uint32>(state.turnCount);
+        features[1] = static_cast<uint32>(state.actingPlayerIndex);
+
+        for (int32 m = 0; m < NumMonsters; m++) {
+            const FMCTSSearchMonster& monster = state.monsters[m];
+            uint32* out = features + 2 + m * MonsterFeatures;
+            out[0] = QuantizeStat(monster.atk);
+            out[1] = QuantizeStat(monster.def);
+            out[2] = QuantizeStat(monster.spd);
+            out[3] = QuantizeCondition(monster.temp);
+            out[4] = QuantizeCondition(monster.hum);
+            out[5] = QuantizeCondition(monster.elev);
+            out[6] = static_cast<uint32>(monster.ap);
+            out[7] = QuantizeStat(monster.score);
+            out[8] = monster.cell;
+        }
+    }
+
+    static void GetPlatformFeatures(const FMCTSSearchPlatform& platform, uint32 (&features)[PlatformFeatures]) {
+        features[0] = QuantizeCondition(platform.temp);
+        features[1] = QuantizeCondition(platform.hum);
+        features[2] = QuantizeCondition(platform.elev);
+        features[3] = platform.statusOrder; // Covers the bitmask too.
+    }
+};
+
 // Interfaces
+// Rules on the Blueprint-facing structs. The agent searches these through FMCTSRuleSetAdapter.
 class IMCTSRuleSet {
 public:
     virtual FMCTSGameState NextState(const FMCTSGameState& state, const FMCTSMove& move) = 0;
@@ -140,6 +601,75 @@ public:
     virtual bool EvaluateTerminalState(const FMCTSGameState& state, int _playerIndex) = 0; // return True if this is a win for given player
 };
 
+// Rules as the search sees them. Native rulesets implement this directly so playouts never allocate.
+// Anything random in a move (e.g. a random target) is drawn from the caller's stream, so the same seed always
+// plays out the same game.
+class IMCTSSearchRuleSet {
+public:
+    virtual FMCTSSearchState NextState(const FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random) = 0;
+    // In-place NextState. With a journal, journal->UndoMove(state) takes the move back again.
+    virtual void ApplyMove(FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random, FMCTSStateJournal* journal = nullptr) {
+        if (journal) {
+            journal->BeginMove(state);
+            journal->SavePlatforms(state, FMCTSSearchState::AllCellsMask);
+        }
+        state = NextState(state, move, random);
+    }
+    virtual void EnumerateMoves(const FMCTSSearchState& state, FMCTSMoveList& outMoves) = 0; // Replaces outMoves' contents
+    virtual bool IsTerminalState(const FMCTSSearchState& state) = 0;
+    virtual bool EvaluateTerminalState(const FMCTSSearchState& state, int _playerIndex) = 0; // return True if this is a win for given player
+    // Rough chance in [0, 1] that the player goes on to win, for playouts cut off before the end of the game. Should be
+    // cheap next to the moves it saves. Defaults to EvaluateTerminalState as 1 or 0, which is how cut-off playouts
+    // have always been scored.
+    virtual float EvaluateState(const FMCTSSearchState& state, int _playerIndex) {
+        return EvaluateTerminalState(state, _playerIndex) ? 1.0f : 0.0f;
+    }
+    // True if the move can lead to different states from the same one (e.g. a random target). The search only ever
+    // holds one sampled outcome of such a move, so it won't take a proof of that outcome as the move's value.
+    virtual bool HasRandomOutcome(const FMCTSSearchState& state, FMCTSMoveId move) { return false; }
+    // Full turns left before the game ends on its own, or -1 if the rules can't tell. The agent's endgame solver only
+    // takes over from playouts on rulesets that answer this.
+    virtual int32 TurnsRemaining(const FMCTSSearchState& state) { return -1; }
+};
+
+// Searches an IMCTSRuleSet (e.g. one written in Blueprint) by converting states and moves on every call.
+// Slow, and moves have to fit in an FMCTSMoveId, but it keeps Blueprint rules working with the native search.
+// Blueprint rules roll their own dice, so searches through here aren't reproducible from the seed.
+class FMCTSRuleSetAdapter : public IMCTSSearchRuleSet {
+public:
+    explicit FMCTSRuleSetAdapter(IMCTSRuleSet* _ruleSet = nullptr) : ruleSet(_ruleSet) {}
+
+    virtual FMCTSSearchState NextState(const FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random) override {
+        const FMCTSGameState nextState = ruleSet->NextState(state.ToGameState(), move.ToMove());
+        if (nextState.monsterStates.Num() < FMCTSSearchState::NumMonsters) {
+            UE_LOG(LogTemp, Error, TEXT("\nNext state empty! Culprit: %s"), *move.ToMove().ToString());
+            return state;
+        }
+        return FMCTSSearchState::FromGameState(nextState);
+    }
+
+    virtual void EnumerateMoves(const FMCTSSearchState& state, FMCTSMoveList& outMoves) override {
+        outMoves.Reset();
+        for (const FMCTSMove& move : ruleSet->EnumerateMoves(state.ToGameState()))
+            outMoves.Add(FMCTSMoveId::FromMove(move));
+    }
+
+    virtual bool IsTerminalState(const FMCTSSearchState& state) override {
+        return ruleSet->IsTerminalState(state.ToGameState());
+    }
+
+    virtual bool EvaluateTerminalState(const FMCTSSearchState& state, int _playerIndex) override {
+        return ruleSet->EvaluateTerminalState(state.ToGameState(), _playerIndex);
+    }
+
+    // Blueprint rules can't say, so assume any move might be.
+    virtual bool HasRandomOutcome(const FMCTSSearchState& state, FMCTSMoveId move) override {
+        return true;
+    }
+
+    IMCTSRuleSet* ruleSet;
+};
+
 UINTERFACE(BlueprintType)
 class UMCTSEvaluatorModel : public UInterface {
     GENERATED_BODY()
@@ -151,87 +681,771 @@ public:
     virtual TArray<float> Evaluate(const FMCTSGameState& state) = 0;
 };
 
+// Visit/win/virtual loss counters for every child slot of a node, structure-of-arrays and indexed like its moves, so
+// selection can score all the children in one pass over contiguous memory.
+// Wins are kept in 1/WinScale playouts, so cut-off playouts' fractional results add up instead of being rounded away.
+// Sized once per node by CacheMoves and never moved while the node is in use, so other threads can keep reading.
+// Only ever grows, so a recycled node doesn't allocate again.
+struct FMCTSChildStats {
+    TUniquePtr<std::atomic<int32>[]> visits;
+    TUniquePtr<std::atomic<int32>[]> wins;
+    TUniquePtr<std::atomic<int32>[]> virtualLoss;
+    TUniquePtr<float[]> priors; // 1 for a normal move, 0 for one selection should only fall back on (end turn).
+    // All-moves-as-first counts for RAVE: playouts from here (or below) that played the slot's move later in the same
+    // turn, and how many of those the move's player won (in 1/WinScale playouts, like wins).
+    // Unlike the counters above these start before the child is expanded, and stay zero unless RAVE is on.
+    TUniquePtr<std::atomic<int32>[]> amafVisits;
+    TUniquePtr<std::atomic<int32>[]> amafWins;
+    int32 capacity = 0;
+
+    static constexpr int32 WinScale = 64;
+
+    void Reserve(int32 num) {
+        if (num <= capacity)
+            return;
+        visits = MakeUnique<std::atomic<int32>[]>(num);
+        wins = MakeUnique<std::atomic<int32>[]>(num);
+        virtualLoss = MakeUnique<std::atomic<int32>[]>(num);
+        priors = MakeUnique<float[]>(num);
+        amafVisits = MakeUnique<std::atomic<int32>[]>(num);
+        amafWins = MakeUnique<std::atomic<int32>[]>(num);
+        capacity = num;
+    }
+};
+
+// Game-theoretic value of a node, for the player to move in it. Unknown until the search proves otherwise.
+enum class EMCTSProof : int8 {
+    Unknown,
+    Win,
+    Loss,
+    Draw
+};
+
 // Node class
+// A node's own counters live in its parent's FMCTSChildStats. The root (or any node without a parent) uses the
+// spare set kept in the node itself.
 class UMCTSNode {
 public:
-    UMCTSNode() : state(), children({}), parent(nullptr), selectionCount(0), winCount(0) {}
-    UMCTSNode(const FMCTSGameState& state) : state(state),  children({}), parent(nullptr), selectionCount(0), winCount(0) {}
+    UMCTSNode() : state(), children({}), parent(nullptr), move(), hash(0), expandedChildren(0), expansionLock(false), proof(EMCTSProof::Unknown), randomOutcome(false), isTerminal(false), movesCached(false) { UseOwnStats(); }
+    UMCTSNode(const FMCTSSearchState& state) : state(state),  children({}), parent(nullptr), move(), hash(0), expandedChildren(0), expansionLock(false), proof(EMCTSProof::Unknown), randomOutcome(false), isTerminal(false), movesCached(false) { UseOwnStats(); }
+
+    // Nodes point into themselves, so they never move (the pool constructs them in place).
+    UMCTSNode(const UMCTSNode&) = delete;
+    UMCTSNode& operator=(const UMCTSNode&) = delete;
+
+    std::atomic<int32>& SelectionCount() { return *selectionCount; }
+    std::atomic<int32>& WinCount() { return *winCount; }
+    std::atomic<int32>& VirtualLoss() { return *virtualLoss; }
+    const std::atomic<int32>& SelectionCount() const { return *selectionCount; }
+    const std::atomic<int32>& WinCount() const { return *winCount; }
+    const std::atomic<int32>& VirtualLoss() const { return *virtualLoss; }
+
+    // Called by the parent's Expand before the child is published: clears slot childIndex of the parent's stats and
+    // moves this node's counters there.
+    void LinkToParentStats(UMCTSNode* newParent, int32 childIndex) {
+        FMCTSChildStats& stats = newParent->childStats;
+        stats.visits[childIndex].store(0, std::memory_order_relaxed);
+        stats.wins[childIndex].store(0, std::memory_order_relaxed);
+        stats.virtualLoss[childIndex].store(0, std::memory_order_relaxed);
+        selectionCount = &stats.visits[childIndex];
+        winCount = &stats.wins[childIndex];
+        virtualLoss = &stats.virtualLoss[childIndex];
+    }
+
+    // Copies the counters out of the parent's stats before the node is cut loose from it (re-rooting).
+    void DetachFromParentStats() {
+        ownSelectionCount.store(selectionCount->load(std::memory_order_relaxed), std::memory_order_relaxed);
+        ownWinCount.store(winCount->load(std::memory_order_relaxed), std::memory_order_relaxed);
+        ownVirtualLoss.store(virtualLoss->load(std::memory_order_relaxed), std::memory_order_relaxed);
+        selectionCount = &ownSelectionCount;
+        winCount = &ownWinCount;
+        virtualLoss = &ownVirtualLoss;
+    }
+
+    // A batch's wins for this node's player, as the parent's player sees them: wins and losses swap whenever the acting
+    // player changes, as they would one result at a time. wins are in 1/FMCTSChildStats::WinScale playouts.
+    int32 WinsForParent(int32 wins, int32 playouts) const {
+        return (parent && parent->state.actingPlayerIndex != state.actingPlayerIndex) ? playouts * FMCTSChildStats::WinScale - wins : wins;
+    }
 
-    void Update(bool win) {
-        //selectionCount++;
-        if (win)
-            winCount++;
+    EMCTSProof GetProof() const { return proof.load(std::memory_order_acquire); }
+    bool IsSolved() const { return GetProof() != EMCTSProof::Unknown; }
 
-        if (parent)
-            parent->Update(win != (parent->state.actingPlayerIndex != state.actingPlayerIndex));
+    // Only the first proof sticks. Returns false if the node was already solved.
+    bool SetProof(EMCTSProof newProof) {
+        EMCTSProof expected = EMCTSProof::Unknown;
+        return proof.compare_exchange_strong(expected, newProof, std::memory_order_acq_rel);
     }
 
-    void ReleaseChildren() {
-        for (auto& pair : children) {
-            pair.Value->ReleaseChildren();
-            delete pair.Value;
+    // Same swap as WinsForParent: a win for this node's player is a loss for the parent's if they differ.
+    // Unknown if the move here had a random outcome, since this node is only one of the states it could have led to.
+    EMCTSProof ProofForParent() const {
+        const EMCTSProof value = randomOutcome ? EMCTSProof::Unknown : GetProof();
+        if (!parent || parent->state.actingPlayerIndex == state.actingPlayerIndex)
+            return value;
+        return value == EMCTSProof::Win ? EMCTSProof::Loss : (value == EMCTSProof::Loss ? EMCTSProof::Win : value);
+    }
+
+    // Minimax over the expanded children: a win if any child is, a loss or draw once every move is expanded and solved.
+    EMCTSProof SolveFromChildren() const {
+        bool bAllSolved = IsFullyExpanded();
+        bool bAnyDraw = false;
+        for (int32 childIndex = 0; childIndex < NumExpandedChildren(); childIndex++) {
+            const EMCTSProof childProof = GetChild(childIndex)->ProofForParent();
+            if (childProof == EMCTSProof::Win)
+                return EMCTSProof::Win;
+            bAllSolved &= childProof != EMCTSProof::Unknown;
+            bAnyDraw |= childProof == EMCTSProof::Draw;
         }
+        if (!bAllSolved)
+            return EMCTSProof::Unknown;
+        return bAnyDraw ? EMCTSProof::Draw : EMCTSProof::Loss;
+    }
+
+    // Clears the node for reuse by the pool, keeping the children array's allocation.
+    void Reset() {
+        children.Reset();
+        parent = nullptr;
+        move = FMCTSMoveId();
+        hash = 0;
+        UseOwnStats();
+        expandedChildren.store(0, std::memory_order_relaxed);
+        expansionLock.store(false, std::memory_order_relaxed);
+        proof.store(EMCTSProof::Unknown, std::memory_order_relaxed);
+        randomOutcome = false;
+        moves.Reset();
+        isTerminal = false;
+        movesCached.store(false, std::memory_order_relaxed);
+    }
+
+    // Legal moves and terminal flag are worked out once, the first time anyone asks, and kept for the node's lifetime.
+    // The untried-move cursor is children.Num(), since children are expanded in move order.
+    // With bCollapseEquivalent, moves that lead to the same state as an earlier move are dropped (see CollapseEquivalentMoves).
+    template<typename TRuleSet>
+    void CacheMoves(TRuleSet* ruleSet, bool bCollapseEquivalent = false) {
+        if (movesCached.load(std::memory_order_acquire))
+            return;
+
+        LockExpansion();
+        if (!movesCached.load(std::memory_order_relaxed)) {
+            isTerminal = ruleSet->IsTerminalState(state);
+            ruleSet->EnumerateMoves(state, moves);
+            if (bCollapseEquivalent && !isTerminal)
+                CollapseEquivalentMoves(ruleSet);
+            // Reserve every child slot up front so readers on other threads never see the arrays move.
+            children.Reserve(moves.Num());
+            childStats.Reserve(moves.Num());
+            for (int32 moveIndex = 0; moveIndex < moves.Num(); moveIndex++) {
+                childStats.priors[moveIndex] = moves[moveIndex].GetMoveIndex() < 0 ? 0.0f : 1.0f;
+                childStats.amafVisits[moveIndex].store(0, std::memory_order_relaxed);
+                childStats.amafWins[moveIndex].store(0, std::memory_order_relaxed);
+            }
+            movesCached.store(true, std::memory_order_release);
+        }
+        UnlockExpansion();
+    }
+
+    // Keeps the first move of each set whose results hash the same (FMCTSStateHasher), so the node only expands distinct
+    // outcomes. Costs one ApplyMove per move, once per node. Only moves with a single outcome are compared: one roll of
+    // a chance move says nothing about the others, so those are always kept, as are end-turn moves.
+    template<typename TRuleSet>
+    void CollapseEquivalentMoves(TRuleSet* ruleSet) {
+        TArray<uint64, TInlineAllocator<64>> outcomes;
+        int32 numKept = 0;
+
+        for (int32 moveIndex = 0; moveIndex < moves.Num(); moveIndex++) {
+            const FMCTSMoveId candidate = moves[moveIndex];
+            if (!candidate.IsEndTurn() && !ruleSet->HasRandomOutcome(state, candidate)) {
+                FMCTSSearchState outcome = state;
+                FMCTSRandom random; // Never drawn from, the move has only the one outcome.
+                ruleSet->ApplyMove(outcome, candidate, random);
+
+                const uint64 outcomeHash = FMCTSStateHasher::Hash(outcome);
+                if (outcomes.Contains(outcomeHash))
+                    continue;
+                outcomes.Add(outcomeHash);
+            }
+            moves[numKept++] = candidate;
+        }
+        moves.SetNum(numKept);
+    }
+
+    bool IsFullyExpanded() const { return NumExpandedChildren() == moves.Num(); }
+
+    // Children other threads may safely read. CacheMoves reserves the array up front so it never moves while searching.
+    int32 NumExpandedChildren() const { return expandedChildren.load(std::memory_order_acquire); }
+    UMCTSNode* GetChild(int32 index) const { return children.GetData()[index]; }
+
+    void LockExpansion() {
+        while (expansionLock.exchange(true, std::memory_order_acquire))
+            FPlatformProcess::Yield();
+    }
+    void UnlockExpansion() { expansionLock.store(false, std::memory_order_release); }
+
+    template<typename Func>
+    void ForEachChild(Func func) const {
+        for (UMCTSNode* child : children)
+            func(child);
     }
 
-    FMCTSGameState state;
-    TMap<FString, UMCTSNode*> children; // Maps FMCTSMove (as string) to UMCTSNode.
+    FMCTSSearchState state;
+    TArray<UMCTSNode*> children; // Same order as EnumerateMoves, so children[i] is the result of the i-th enumerated move.
     UMCTSNode* parent;
-    int selectionCount;
-    int winCount;
+    FMCTSMoveId move; // The move that led here from parent.
+    uint64 hash;      // FMCTSStateHasher hash of state, only filled in while the transposition table is on.
+    std::atomic<int32> expandedChildren; // Published children.Num(), see NumExpandedChildren.
+    std::atomic<bool> expansionLock;
+    std::atomic<EMCTSProof> proof; // See SetProof.
+    bool randomOutcome;            // move could have led somewhere else (IMCTSSearchRuleSet::HasRandomOutcome).
+
+    // Filled in by CacheMoves.
+    FMCTSMoveList moves;
+    bool isTerminal;
+    std::atomic<bool> movesCached;
+    FMCTSChildStats childStats;
+
+private:
+    void UseOwnStats() {
+        ownSelectionCount.store(0, std::memory_order_relaxed);
+        ownWinCount.store(0, std::memory_order_relaxed);
+        ownVirtualLoss.store(0, std::memory_order_relaxed);
+        selectionCount = &ownSelectionCount;
+        winCount = &ownWinCount;
+        virtualLoss = &ownVirtualLoss;
+    }
+
+    // Point at this node's slot in parent->childStats, or at the own* counters.
+    std::atomic<int32>* selectionCount;
+    std::atomic<int32>* winCount;
+    std::atomic<int32>* virtualLoss; // Pending visits from threads still simulating below this node (tree-parallel only).
+    std::atomic<int32> ownSelectionCount{ 0 };
+    std::atomic<int32> ownWinCount{ 0 };
+    std::atomic<int32> ownVirtualLoss{ 0 };
+};
+
+// Counters for the endgame solver, logged after each decision.
+struct FMCTSEndgameStats {
+    int64 solves = 0;  // Positions handed to the solver.
+    int64 exact = 0;   // Of those, solved without sampling a random move.
+    int64 aborted = 0; // Gave up at the node limit and went back to playouts.
+    int64 nodes = 0;   // Positions searched, across every solve.
+};
+
+// Alpha-beta search to the end of the game, for nodes close enough to it that playouts are just noise.
+// Values are for the player to move: 1 a win, 0.5 a draw, 0 a loss. A player can make several moves in a row, so a
+// child's value only flips when the player to move changes. Moves with a random outcome are averaged over
+// chanceSamples rolls instead, so any solve that meets one is an estimate rather than exact.
+// Finished positions go in a small lockless table, so search threads share them and racing writes are just misses.
+template<typename TRuleSet>
+class TMCTSEndgameSolver {
+public:
+    TMCTSEndgameSolver() : mask(0) {}
+
+    // tableSizeLog2 <= 0 frees the table (and solves without one).
+    void Configure(int32 tableSizeLog2, int32 _nodeLimit, int32 _chanceSamples) {
+        entries.Reset();
+        mask = 0;
+        if (tableSizeLog2 > 0) {
+            const uint64 size = uint64(1) << FMath::Min(tableSizeLog2, 30);
+            entries = MakeUnique<FEntry[]>(size);
+            mask = size - 1;
+        }
+        nodeLimit = FMath::Max(_nodeLimit, 1);
+        chanceSamples = FMath::Max(_chanceSamples, 1);
+    }
+
+    // False if the search ran past nodeLimit positions, in which case the outputs are left alone.
+    bool Solve(TRuleSet& ruleSet, const FMCTSSearchState& state, FMCTSRandom& random, float& outValue, bool& bOutExact) {
+        FSearch search(ruleSet, random);
+        FMCTSSearchState scratch = state;
+        const float value = Search(search, scratch, 0.0f, 1.0f);
+
+        solves.fetch_add(1, std::memory_order_relaxed);
+        nodes.fetch_add(search.nodes, std::memory_order_relaxed);
+        if (IsAborted(search)) {
+            aborted.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (search.bExact)
+            exact.fetch_add(1, std::memory_order_relaxed);
+        outValue = value;
+        bOutExact = search.bExact;
+        return true;
+    }
+
+    FMCTSEndgameStats GetStats() const {
+        FMCTSEndgameStats stats;
+        stats.solves = solves.load();
+        stats.exact = exact.load();
+        stats.aborted = aborted.load();
+        stats.nodes = nodes.load();
+        return stats;
+    }
+
+private:
+    static constexpr uint64 ExactBit = uint64(1) << 34;
+    static constexpr uint64 ValidBit = uint64(1) << 35;
+    static constexpr int32 MaxDepth = 64;
+
+    enum EBound : uint64 { Exact, Lower, Upper };
+
+    // data packs the value's bits, the bound, an exact flag and a valid bit. key is stored XORed with data, so a
+    // torn write reads back as a miss.
+    struct FEntry {
+        std::atomic<uint64> check{ 0 };
+        std::atomic<uint64> data{ 0 };
+    };
+
+    struct FSearch {
+        FSearch(TRuleSet& _ruleSet, FMCTSRandom& _random) : ruleSet(_ruleSet), random(_random) {}
+
+        TRuleSet& ruleSet;
+        FMCTSRandom& random;
+        FMCTSStateJournal journal;
+        FMCTSMoveList moves[MaxDepth];
+        int64 nodes = 0;
+        int32 depth = 0;
+        bool bExact = true;
+    };
+
+    float Search(FSearch& search, FMCTSSearchState& state, float alpha, float beta) {
+        if (search.ruleSet.IsTerminalState(state)) {
+            if (search.ruleSet.EvaluateTerminalState(state, state.actingPlayerIndex))
+                return 1.0f;
+            return search.ruleSet.EvaluateTerminalState(state, 1 - state.actingPlayerIndex) ? 0.0f : 0.5f;
+        }
+        // Past the limit every call bails straight out; Solve throws the value away.
+        if (++search.nodes > nodeLimit)
+            return 0.5f;
+        if (search.depth >= MaxDepth) {
+            search.bExact = false;
+            return 0.5f;
+        }
+
+        const uint64 key = entries.IsValid() ? FMCTSStateHasher::Hash(state) : 0;
+        if (key) {
+            float value;
+            EBound bound;
+            bool bEntryExact;
+            if (Probe(key, value, bound, bEntryExact) && (bound == Exact || (bound == Lower && value >= beta) || (bound == Upper && value <= alpha))) {
+                search.bExact &= bEntryExact;
+                return value;
+            }
+        }
+
+        const float alphaIn = alpha;
+        const bool bExactIn = search.bExact;
+        search.bExact = true;
+
+        FMCTSMoveList& moves = search.moves[search.depth];
+        search.ruleSet.EnumerateMoves(state, moves);
+        float best = 0.0f;
+        for (const FMCTSMoveId move : moves) {
+            float value = 0.0f;
+            if (search.ruleSet.HasRandomOutcome(state, move)) {
+                // Samples are searched with the full window, bounds from one roll say nothing about the average.
+                for (int32 sample = 0; sample < chanceSamples; sample++)
+                    value += SearchChild(search, state, move, 0.0f, 1.0f);
+                value /= chanceSamples;
+                search.bExact = false;
+            }
+            else {
+                value = SearchChild(search, state, move, alpha, beta);
+            }
+            best = FMath::Max(best, value);
+            alpha = FMath::Max(alpha, value);
+            if (alpha >= beta || IsAborted(search))
+                break;
+        }
+
+        // A value from an abandoned search is garbage, keep it out of the table.
+        if (key && !IsAborted(search))
+            Store(key, best, best <= alphaIn ? Upper : best >= beta ? Lower : Exact, search.bExact);
+        search.bExact &= bExactIn;
+        return best;
+    }
+
+    bool IsAborted(const FSearch& search) const { return search.nodes > nodeLimit; }
+
+    float SearchChild(FSearch& search, FMCTSSearchState& state, FMCTSMoveId move, float alpha, float beta) {
+        const int actingPlayerIndex = state.actingPlayerIndex;
+        search.ruleSet.ApplyMove(state, move, search.random, &search.journal);
+        search.depth++;
+        const float value = state.actingPlayerIndex == actingPlayerIndex
+            ? Search(search, state, alpha, beta)
+            : 1.0f - Search(search, state, 1.0f - beta, 1.0f - alpha);
+        search.depth--;
+        search.journal.UndoMove(state);
+        return value;
+    }
+
+    bool Probe(uint64 key, float& outValue, EBound& outBound, bool& bOutExact) const {
+        const FEntry& entry = entries[key & mask];
+        const uint64 data = entry.data.load(std::memory_order_relaxed);
+        if (!(data & ValidBit) || (entry.check.load(std::memory_order_relaxed) ^ data) != key)
+            return false;
+        const uint32 valueBits = static_cast<uint32>(data);
+        FMemory::Memcpy(&outValue, &valueBits, sizeof(float));
+        outBound = static_cast<EBound>((data >> 32) & 3);
+        bOutExact = (data & ExactBit) != 0;
+        return true;
+    }
+
+    void Store(uint64 key, float value, EBound bound, bool bExact) {
+        uint32 valueBits;
+        FMemory::Memcpy(&valueBits, &value, sizeof(float));
+        const uint64 data = valueBits | static_cast<uint64>(bound) << 32 | (bExact ? ExactBit : 0) | ValidBit;
+        FEntry& entry = entries[key & mask];
+        entry.check.store(key ^ data, std::memory_order_relaxed);
+        entry.data.store(data, std::memory_order_relaxed);
+    }
+
+    TUniquePtr<FEntry[]> entries;
+    uint64 mask;
+    int32 nodeLimit = 20000;
+    int32 chanceSamples = 4;
+    std::atomic<int64> solves{ 0 };
+    std::atomic<int64> exact{ 0 };
+    std::atomic<int64> aborted{ 0 };
+    std::atomic<int64> nodes{ 0 };
+};
+
+// How Decide spreads its search over threads.
+enum class EMCTSParallelMode : uint8 {
+    Single, // One tree, searched on the calling thread.
+    Root,   // One tree per thread, each with its own RNG stream; root child statistics are merged before choosing.
+    Tree    // One shared tree searched by every thread, with virtual loss to keep threads on different branches.
+};
+
+// Counters for the agent, logged after each decision.
+struct FMCTSSearchStats {
+    int64 iterations = 0;           // Across every search this agent has run.
+    int64 lastSearchIterations = 0; // From the most recent RunSearch, handy for tuning time budgets.
+    FMCTSTranspositionStats transpositions;
+    FMCTSEndgameStats endgame;
+};
+
+// Selection, playout and backup rules for TMCTSAgent, as static functions so the search loops can inline them.
+// Write another struct with the same functions to change how the agent searches.
+struct FMCTSDefaultPolicy {
+    static constexpr float IdleScore = -0.5f; // disprefer idleness!
+
+    // UCB1 for numChildren children (a multiple of 4), four per vector op: the parent's log term is worked out once
+    // and each child's sqrt is a fast reciprocal square root. Unvisited children score +inf, and children with a zero
+    // prior (end turn) a flat IdleScore.
+    static void ScoreChildren(const float* wins, const float* visits, const float* priors, int32 numChildren, int32 parentVisits, float* outScores) {
+        const VectorRegister4Float exploration = VectorSetFloat1(2 * std::sqrt(std::log(static_cast<float>(parentVisits))));
+        const VectorRegister4Float zero = VectorZeroFloat();
+        const VectorRegister4Float unvisited = VectorSetFloat1(std::numeric_limits<float>::infinity());
+        const VectorRegister4Float idle = VectorSetFloat1(IdleScore);
+
+        for (int32 childIndex = 0; childIndex < numChildren; childIndex += 4) {
+            const VectorRegister4Float childVisits = VectorLoad(visits + childIndex);
+            const VectorRegister4Float exploitation = VectorDivide(VectorLoad(wins + childIndex), childVisits);
+            VectorRegister4Float score = VectorAdd(exploitation, VectorMultiply(exploration, VectorReciprocalSqrtEstimate(childVisits)));
+            score = VectorSelect(VectorCompareGT(childVisits, zero), score, unvisited);
+            score = VectorSelect(VectorCompareGT(VectorLoad(priors + childIndex), zero), score, idle);
+            VectorStore(score, outScores + childIndex);
+        }
+    }
+
+    // Traditional MCTS: just run moves randomly during sim.
+    template<typename TRuleSet>
+    static int32 ChoosePlayoutMove(TRuleSet& ruleSet, const FMCTSSearchState& state, const FMCTSMoveList& moves, FMCTSRandom& random) {
+        return random.RandRange(0, moves.Num() - 1);
+    }
+
+    // Wins and losses swap whenever the acting player changes on the way up.
+    static int32 WinsForParent(const UMCTSNode& node, int32 wins, int32 playouts) {
+        return node.WinsForParent(wins, playouts);
+    }
+};
+
+// The calls a game makes on an agent once it's set up, whatever ruleset the agent was compiled against.
+// One virtual call per decision, nothing in the search itself goes through here.
+class IMCTSAgent {
+public:
+    virtual ~IMCTSAgent() {}
+
+    virtual TArray<FMCTSMove> Decide(const FMCTSGameState& gameState, int perspectiveIndex) = 0;
+    virtual bool BeginSearch(const FMCTSGameState& gameState, int perspectiveIndex) = 0;
+    virtual bool StepSearch(double sliceMicroseconds) = 0;
+    virtual TArray<FMCTSMove> FinishSearch() = 0;
+    virtual void SyncRoot(const FMCTSGameState& state, int maxDepth = 8) = 0;
+    virtual void ObserveMove(const FMCTSMove& move) = 0;
+    virtual int64 Ponder(const std::atomic<bool>& stopFlag) = 0;
+    virtual void SetDecisionBudget(int budget) = 0;
+    virtual void SetTimeBudget(float milliseconds) = 0;
 };
 
 // Agent class
-class UMCTSAgent {
+// Bound to its ruleset and policy at compile time, so NextState/EnumerateMoves/... and the policy calls can be
+// inlined into the search loops (mark the ruleset class final so the compiler knows nothing overrides it).
+// UMCTSAgent below searches any IMCTSSearchRuleSet through virtual calls instead, e.g. the Blueprint adapter.
+template<typename TRuleSet, typename TPolicy = FMCTSDefaultPolicy>
+class TMCTSAgent : public IMCTSAgent {
 
 public:
-    IMCTSRuleSet* ruleSet;
+    TRuleSet* ruleSet;
     IMCTSEvaluatorModel* model;
 
-    UMCTSAgent(int budget)
-        : playerIndex(0), maxSimulationDepth(150), decisionBudget(budget), playoutBudget(10), rootNode(nullptr) {}
+    TMCTSAgent(int budget)
+        : ruleSet(nullptr), model(nullptr), playerIndex(0), maxSimulationDepth(150), decisionBudget(budget), playoutBudget(10), rootNode(nullptr),
+          parallelMode(EMCTSParallelMode::Single), searchThreads(1), virtualLossPerThread(1), bParallelPlayouts(false), bCollapseEquivalentMoves(false), seed(static_cast<int32>(FPlatformTime::Cycles())) {
+        ResetRandomStreams();
+    }
 
     //UMCTSAgent(int playerIndex, int maxSimulationDepth, int decisionBudget)
     //    : playerIndex(playerIndex), maxSimulationDepth(maxSimulationDepth), decisionBudget(decisionBudget) {}
 
-    ~UMCTSAgent() {
-        if (rootNode) {
-            rootNode->ReleaseChildren();
-            delete rootNode;
+    // Nodes belong to the pool, which frees every slab when the agent goes away.
+    TMCTSAgent(const TMCTSAgent&) = delete;
+    TMCTSAgent& operator=(const TMCTSAgent&) = delete;
+
+    const FMCTSNodePoolStats& GetNodePoolStats() const { return nodePool.GetStats(); }
+
+    // The current tree, for tests and debugging. Null until the first search.
+    const UMCTSNode* GetRootNode() const { return rootNode; }
+
+    FMCTSSearchStats GetSearchStats() const {
+        FMCTSSearchStats stats;
+        stats.iterations = totalIterations;
+        stats.lastSearchIterations = lastSearchIterations;
+        stats.transpositions = transpositions.GetStats();
+        stats.endgame = endgameSolver.GetStats();
+        return stats;
+    }
+
+    // Pools statistics of identical states reached by different move orders. sizeLog2 <= 0 turns it off.
+    // Only takes effect for trees started after the call.
+    void SetTranspositionTable(int32 sizeLog2) {
+        transpositions.Resize(sizeLog2);
+    }
+
+    // With more than one thread, decisionBudget (or the time budget) is spent by every thread, so more threads means
+    // more total iterations.
+    void SetParallelism(EMCTSParallelMode _parallelMode, int32 _searchThreads) {
+        parallelMode = _parallelMode;
+        searchThreads = FMath::Max(_searchThreads, 1);
+        ResetRandomStreams();
+    }
+
+    // Anytime mode: each search runs until this many milliseconds have passed, with decisionBudget as an optional
+    // iteration cap (<= 0 for none). A budget <= 0 goes back to plain iteration counts.
+    virtual void SetTimeBudget(float milliseconds) override {
+        timeBudgetMs = milliseconds;
+    }
+
+    // Runs each expansion's playoutBudget playouts as a parallel batch.
+    void SetParallelPlayouts(bool _bParallelPlayouts) {
+        bParallelPlayouts = _bParallelPlayouts;
+    }
+
+    // Stops each playout after this many moves and scores it with IMCTSSearchRuleSet::EvaluateState instead of playing
+    // on to maxSimulationDepth or the end of the game. <= 0 plays every game out.
+    void SetPlayoutCutoff(int32 moves) {
+        playoutCutoff = FMath::Max(moves, 0);
+    }
+
+    // RAVE: selection blends each child's own win rate with its all-moves-as-first rate (how playouts through the
+    // parent did whenever the same player made that move later in the same turn), trusting AMAF less as the child's
+    // own visits grow. equivalence is roughly the visit count at which both count the same. <= 0 turns it off.
+    // Moves recur every turn, so counting them across the whole game would rate them all about the same.
+    // Playouts then run one at a time on the search thread, since AMAF needs the moves each one played.
+    void SetRave(int32 equivalence) {
+        raveEquivalence = FMath::Max(equivalence, 0);
+    }
+
+    // Expands only one move per distinct resulting state. Worth it when many moves do the same thing, at the price of
+    // one extra ApplyMove per move per node. Only takes effect for nodes created after the call.
+    void SetCollapseEquivalentMoves(bool _bCollapseEquivalentMoves) {
+        bCollapseEquivalentMoves = _bCollapseEquivalentMoves;
+    }
+
+    // Searches nodes with at most turnsRemaining turns left (IMCTSSearchRuleSet::TurnsRemaining) to the end of the game
+    // instead of playing them out, and proves the ones that come out exact. Solves that need more than nodeLimit
+    // positions fall back to playouts. turnsRemaining <= 0 turns the solver off.
+    void SetEndgameSolver(int32 turnsRemaining, int32 nodeLimit = 20000, int32 tableSizeLog2 = 16) {
+        endgameTurns = turnsRemaining;
+        endgameSolver.Configure(turnsRemaining > 0 ? tableSizeLog2 : 0, nodeLimit, 4);
+    }
+
+    // Restarts every thread's stream from the seed. With an iteration budget, a fresh agent then makes the same decisions
+    // bit for bit in single-threaded and root-parallel mode (tree-parallel and time budgets depend on thread timing,
+    // and so does a transposition table shared by root-parallel threads).
+    void SetSeed(int32 _seed) {
+        seed = _seed;
+        ResetRandomStreams();
+    }
+
+    // Grows the tree for the given state by one decision budget without committing to a move.
+    // Returns the number of iterations run across all threads.
+    int64 RunSearch(const FMCTSGameState& gameState) {
+        return RunSearch(FMCTSSearchState::FromGameState(gameState));
+    }
+
+    int64 RunSearch(const FMCTSSearchState& state) {
+        if (ruleSet == nullptr || ruleSet->IsTerminalState(state))
+            return 0;
+
+        EnsureRoot(state);
+
+        searchDeadline = timeBudgetMs > 0.0f ? FPlatformTime::Seconds() + timeBudgetMs / 1000.0 : 0.0;
+
+        int64 iterations = 0;
+        if (parallelMode == EMCTSParallelMode::Root && searchThreads > 1)
+            iterations = RunRootParallel();
+        else if (parallelMode == EMCTSParallelMode::Tree && searchThreads > 1)
+            iterations = RunTreeParallel();
+        else
+            iterations = RunIterations(rootNode, nodePool, randomStreams[0], decisionBudget, false);
+
+        totalIterations += iterations;
+        lastSearchIterations = iterations;
+        if (rootNode->IsSolved()) {
+            const EMCTSProof proof = rootNode->GetProof();
+            UE_LOG(LogTemp, Display, TEXT("Root is a proven %s, stopped after %lld iterations."),
+                proof == EMCTSProof::Win ? TEXT("win") : (proof == EMCTSProof::Loss ? TEXT("loss") : TEXT("draw")), iterations);
         }
+        return iterations;
     }
 
-    TArray<FMCTSMove> Decide(const FMCTSGameState& state, int perspectiveIndex) {
+    virtual TArray<FMCTSMove> Decide(const FMCTSGameState& gameState, int perspectiveIndex) override {
         playerIndex = perspectiveIndex;
+        const FMCTSSearchState state = FMCTSSearchState::FromGameState(gameState);
 
         // Default move if no ruleset set
         if (ruleSet == nullptr || ruleSet->IsTerminalState(state))
             return { FMCTSMove(playerIndex) };
 
         // Create a tree with all the scores resulting from MCTS algorithm
+        const double searchStart = FPlatformTime::Seconds();
+        const int64 iterations = RunSearch(state);
+        UE_LOG(LogTemp, Display, TEXT("Searched %lld iterations in %.1fms."), iterations, (FPlatformTime::Seconds() - searchStart) * 1000.0);
+
+        return ChooseMoves();
+    }
+
+    // Resumable version of Decide, for callers that can only spare a slice of each frame: BeginSearch once, StepSearch
+    // every tick until it returns true, then FinishSearch for the moves. Single-threaded, and the tree is kept as-is
+    // between slices. Returns false if there's nothing to search (FinishSearch then hands back the default move).
+    virtual bool BeginSearch(const FMCTSGameState& gameState, int perspectiveIndex) override {
+        playerIndex = perspectiveIndex;
+        slicedIterations = 0;
+        const FMCTSSearchState state = FMCTSSearchState::FromGameState(gameState);
+
+        if (ruleSet == nullptr || ruleSet->IsTerminalState(state)) {
+            bSlicedSearchValid = false;
+            bSlicedSearchDone = true;
+            return false;
+        }
+
+        EnsureRoot(state);
+        slicedSearchDeadline = timeBudgetMs > 0.0f ? FPlatformTime::Seconds() + timeBudgetMs / 1000.0 : 0.0;
+        bSlicedSearchValid = true;
+        bSlicedSearchDone = slicedSearchDeadline <= 0.0 && decisionBudget <= 0;
+        return true;
+    }
+
+    // Runs iterations for roughly sliceMicroseconds (at least one per call, so the search always moves on).
+    // Returns true once the iteration or time budget is used up.
+    virtual bool StepSearch(double sliceMicroseconds) override {
+        if (bSlicedSearchDone)
+            return true;
+
+        searchDeadline = FPlatformTime::Seconds() + sliceMicroseconds / 1000000.0;
+        if (slicedSearchDeadline > 0.0)
+            searchDeadline = FMath::Min(searchDeadline, slicedSearchDeadline);
+
+        const int remainingIterations = decisionBudget > 0 ? decisionBudget - static_cast<int>(slicedIterations) : 0;
+        const int64 iterations = RunIterations(rootNode, nodePool, randomStreams[0], remainingIterations, false);
+        slicedIterations += iterations;
+        totalIterations += iterations;
+
+        const bool bOutOfIterations = decisionBudget > 0 && slicedIterations >= decisionBudget;
+        const bool bOutOfTime = slicedSearchDeadline > 0.0 && FPlatformTime::Seconds() >= slicedSearchDeadline;
+        bSlicedSearchDone = bOutOfIterations || bOutOfTime || rootNode->IsSolved();
+        if (bSlicedSearchDone)
+            lastSearchIterations = slicedIterations;
+        return bSlicedSearchDone;
+    }
+
+    // For agents kept alive across turns. Makes sure the tree is rooted at the real game state, reusing whichever
+    // node up to maxDepth moves below the root holds it (a whole opponent turn is several moves), and only starting
+    // over when none does.
+    virtual void SyncRoot(const FMCTSGameState& state, int maxDepth = 8) override {
         if (!rootNode)
-            rootNode = new UMCTSNode(state);
+            return;
 
-        for (int i = 0; i < decisionBudget; i++) {
-            UMCTSNode* selectedNode = rootNode;
-            UMCTSNode* expandedNode = nullptr;
+        UMCTSNode* match = FindState(rootNode, FMCTSStateHasher::Hash(FMCTSSearchState::FromGameState(state)), maxDepth);
+        if (match == rootNode)
+            return;
 
-            // UE_LOG(LogTemp, Display, TEXT("\n(#%d) Starting at root:\n%s"), i, *DebugNodeString(rootNode));
+        if (match) {
+            UE_LOG(LogTemp, Display, TEXT("Reusing a saved subtree (%d visits) for the new game state."), match->SelectionCount().load());
+            RerootTo(match);
+            return;
+        }
 
-            selectedNode = Select(selectedNode);
-            // UE_LOG(LogTemp, Display, TEXT("\nSelected:\n%s"), *DebugNodeString(selectedNode));
-            
-            expandedNode = Expand(selectedNode);
-            
-            if (expandedNode) {
-                // UE_LOG(LogTemp, Display, TEXT("\nSimulating...:\n%s"), *DebugNodeString(expandedNode));
-                for (int j = 0; j < playoutBudget; j++) {
-                    bool win = Simulate(expandedNode);
-                    // UE_LOG(LogTemp, Display, TEXT("\n...Result: %s.Sending back Update."), win ? TEXT("Win!") : TEXT("Lose."));
-                    Update(expandedNode, win);
-                }
-            }
+        UE_LOG(LogTemp, Display, TEXT("Game state isn't in the saved tree, starting a fresh one."));
+        ResetTree();
+    }
+
+    // Re-roots onto a move that was actually played, e.g. the opponent's. If it was never expanded, the tree restarts
+    // from the resulting state.
+    virtual void ObserveMove(const FMCTSMove& move) override {
+        if (!rootNode || ruleSet == nullptr || ValidateMove(move))
+            return;
+
+        const FMCTSSearchState nextState = ruleSet->NextState(rootNode->state, FMCTSMoveId::FromMove(move), randomStreams[0]);
+        ResetTree();
+        EnsureRoot(nextState);
+    }
+
+    // Keeps growing the current tree on the calling thread until stopFlag is raised, e.g. while the opponent thinks.
+    // Also stops once the tree holds ponderNodeLimit nodes, so a long think can't eat all the memory.
+    // The caller must make sure nothing else touches the agent meanwhile.
+    virtual int64 Ponder(const std::atomic<bool>& stopFlag) override {
+        if (!rootNode || ruleSet == nullptr || IsTerminal(rootNode))
+            return 0;
+
+        searchDeadline = 0.0;
+        int64 iterations = 0;
+        // The pool's liveNodes still counts released subtrees it hasn't reused yet, so count what the tree really
+        // holds. An iteration adds at most one node.
+        int64 treeNodes = CountNodes(rootNode);
+        while (!stopFlag.load(std::memory_order_relaxed) && treeNodes < ponderNodeLimit && !rootNode->IsSolved()) {
+            iterations += RunIterations(rootNode, nodePool, randomStreams[0], 1, false);
+            treeNodes++;
         }
 
+        totalIterations += iterations;
+        UE_LOG(LogTemp, Display, TEXT("Pondered %lld iterations."), iterations);
+        return iterations;
+    }
+
+    void ResetTree() {
+        nodePool.Release(rootNode);
+        rootNode = nullptr;
+    }
+
+    virtual void SetDecisionBudget(int budget) override {
+        decisionBudget = budget;
+    }
+
+    virtual TArray<FMCTSMove> FinishSearch() override {
+        if (!bSlicedSearchValid)
+            return { FMCTSMove(playerIndex) };
+
+        UE_LOG(LogTemp, Display, TEXT("Searched %lld iterations over time slices."), slicedIterations);
+        bSlicedSearchValid = false;
+        return ChooseMoves();
+    }
+
+private:
+
+    // Picks the move(s) to play from the current tree and re-roots onto the first one.
+    TArray<FMCTSMove> ChooseMoves() {
         // Now, assemble a list of moves for the correct player by traversing the tree.
         // UE_LOG(LogTemp, Display, TEXT("\nStarting root at end of tree construction:\n%s"), *DebugNodeString(rootNode));
 
@@ -271,52 +1485,246 @@ public:
 
         //Auto-validate decisions as there's no need to go back to game thread to check.
         ValidateMove(moveList[0]);
+
+        const FMCTSNodePoolStats& poolStats = nodePool.GetStats();
+        UE_LOG(LogTemp, Display, TEXT("Node pool: %lld live (peak %lld), %lld acquired, %lld recycled, %lld subtrees released, %lld slabs."),
+            poolStats.liveNodes, poolStats.peakLiveNodes, poolStats.nodesAcquired, poolStats.nodesRecycled, poolStats.subtreesReleased, poolStats.slabsAllocated);
+
+        if (transpositions.IsEnabled()) {
+            const FMCTSTranspositionStats ttStats = transpositions.GetStats();
+            UE_LOG(LogTemp, Display, TEXT("Transpositions: %.1f%% hit rate (%lld/%lld probes), %lld stores, %lld replacements."),
+                ttStats.HitRate() * 100.0f, ttStats.hits, ttStats.probes, ttStats.stores, ttStats.replacements);
+        }
+
+        if (endgameTurns > 0) {
+            const FMCTSEndgameStats endgameStats = endgameSolver.GetStats();
+            UE_LOG(LogTemp, Display, TEXT("Endgame solver: %lld solves (%lld exact, %lld over the node limit), %lld positions searched."),
+                endgameStats.solves, endgameStats.exact, endgameStats.aborted, endgameStats.nodes);
+        }
         
         return moveList;
     }
 
-private:
+    // Scratch tree for one extra root-parallel thread. The pool is kept between decisions and bulk-reset.
+    struct FMCTSRootWorker {
+        TMCTSNodePool<UMCTSNode> pool;
+        UMCTSNode* root = nullptr;
+    };
+
+    void EnsureRoot(const FMCTSSearchState& state) {
+        if (!rootNode) {
+            rootNode = NewNode(nodePool, state, nullptr);
+            if (transpositions.IsEnabled())
+                rootNode->hash = FMCTSStateHasher::Hash(state);
+        }
+    }
+
+    UMCTSNode* NewNode(TMCTSNodePool<UMCTSNode>& pool, const FMCTSSearchState& state, UMCTSNode* parent) {
+        UMCTSNode* node = pool.Acquire();
+        node->state = state;
+        node->parent = parent;
+        return node;
+    }
+
+    const FMCTSMoveList& GetMoves(UMCTSNode* node) {
+        node->CacheMoves(ruleSet, bCollapseEquivalentMoves);
+        return node->moves;
+    }
+
+    bool IsTerminal(UMCTSNode* node) {
+        node->CacheMoves(ruleSet, bCollapseEquivalentMoves);
+        return node->isTerminal;
+    }
+
+    void ResetRandomStreams() {
+        randomStreams.Reset();
+        for (int32 streamIndex = 0; streamIndex < searchThreads; streamIndex++)
+            randomStreams.Add(FMCTSRandom(static_cast<uint32>(seed), streamIndex));
+    }
+
+    // bShared is set when other threads are growing the same tree (tree-parallel mode).
+    // Runs until `iterations` are done or the search deadline passes, whichever comes first (iterations <= 0 means no
+    // cap when there's a deadline). The first iteration always runs so there's a move to return. Returns iterations run.
+    int64 RunIterations(UMCTSNode* root, TMCTSNodePool<UMCTSNode>& pool, FMCTSRandom& random, int iterations, bool bShared) {
+        const int32 pathVirtualLoss = bShared ? virtualLossPerThread : 0;
+        const bool bHasDeadline = searchDeadline > 0.0;
+        if (!bHasDeadline && iterations <= 0)
+            return 0;
+
+        int i = 0;
+        for (; (iterations <= 0 || i < iterations); i++) {
+            if (bHasDeadline && i > 0 && FPlatformTime::Seconds() >= searchDeadline)
+                break;
+            // A solved root already knows its best move.
+            if (root->IsSolved())
+                break;
+
+            UMCTSNode* selectedNode = root;
+            UMCTSNode* expandedNode = nullptr;
+
+            // UE_LOG(LogTemp, Display, TEXT("\n(#%d) Starting at root:\n%s"), i, *DebugNodeString(root));
+
+            selectedNode = Select(selectedNode, true, pathVirtualLoss);
+            // UE_LOG(LogTemp, Display, TEXT("\nSelected:\n%s"), *DebugNodeString(selectedNode));
+
+            if (selectedNode->IsSolved()) {
+                // Nothing left to search below it, just back up the known result.
+                Update(selectedNode, ProvenWins(selectedNode, playoutBudget), playoutBudget);
+            }
+            else {
+                expandedNode = Expand(selectedNode, pool, random, bShared);
+            }
+
+            if (expandedNode) {
+                int32 wins = 0;
+                if (ruleSet->IsTerminalState(expandedNode->state)) {
+                    Solve(expandedNode);
+                    wins = ProvenWins(expandedNode, playoutBudget);
+                }
+                else if (!SolveEndgame(expandedNode, random, wins)) {
+                    // UE_LOG(LogTemp, Display, TEXT("\nSimulating...:\n%s"), *DebugNodeString(expandedNode));
+                    wins = SimulateBatch(expandedNode, random);
+                    // UE_LOG(LogTemp, Display, TEXT("\n...Result: %d/%d wins. Sending back Update."), wins, playoutBudget);
+                }
+                Update(expandedNode, wins, playoutBudget);
+            }
+
+            if (pathVirtualLoss > 0)
+                RemoveVirtualLoss(selectedNode, pathVirtualLoss);
+        }
+        return i;
+    }
+
+    // Every thread runs decisionBudget iterations on the one tree.
+    int64 RunTreeParallel() {
+        std::atomic<int64> iterations(0);
+        ParallelFor(searchThreads, [this, &iterations](int32 threadIndex) {
+            iterations.fetch_add(RunIterations(rootNode, nodePool, randomStreams[threadIndex], decisionBudget, true), std::memory_order_relaxed);
+        });
+        return iterations.load();
+    }
+
+    void RemoveVirtualLoss(UMCTSNode* pathEnd, int32 amount) {
+        for (UMCTSNode* node = pathEnd; node; node = node->parent)
+            node->VirtualLoss().fetch_sub(amount, std::memory_order_relaxed);
+    }
+
+    // Searches one independent tree per thread, then folds the extra trees' root child counts into rootNode.
+    // Children line up by index because EnumerateMoves is deterministic for a given state.
+    int64 RunRootParallel() {
+        const int32 numTrees = searchThreads;
+
+        while (rootWorkers.Num() < numTrees - 1)
+            rootWorkers.Add(MakeUnique<FMCTSRootWorker>());
+
+        const FMCTSSearchState rootState = rootNode->state;
+        std::atomic<int64> iterations(0);
+        ParallelFor(numTrees, [this, &rootState, &iterations](int32 treeIndex) {
+            if (treeIndex == 0) {
+                iterations.fetch_add(RunIterations(rootNode, nodePool, randomStreams[0], decisionBudget, false), std::memory_order_relaxed);
+                return;
+            }
 
-    void ValidateMove(FMCTSMove validMove) {
-        if (rootNode && rootNode->children.Contains(validMove.ToString())) {
-            UMCTSNode* newRoot = rootNode->children[validMove.ToString()];
+            FMCTSRootWorker& worker = *rootWorkers[treeIndex - 1];
+            worker.pool.ReleaseAll();
+            worker.root = NewNode(worker.pool, rootState, nullptr);
+            worker.root->hash = rootNode->hash;
+            iterations.fetch_add(RunIterations(worker.root, worker.pool, randomStreams[treeIndex], decisionBudget, false), std::memory_order_relaxed);
+        });
+
+        for (int32 workerIndex = 0; workerIndex < numTrees - 1; workerIndex++) {
+            FMCTSRootWorker& worker = *rootWorkers[workerIndex];
+            MergeRootStatistics(worker.root);
+            worker.pool.ReleaseAll();
+            worker.root = nullptr;
+        }
+
+        return iterations.load();
+    }
 
-            // Discard uneeded branches
-            rootNode->children.Remove(validMove.ToString());
-            rootNode->ReleaseChildren();
-            delete rootNode;
+    void MergeRootStatistics(const UMCTSNode* otherRoot) {
+        rootNode->SelectionCount() += otherRoot->SelectionCount();
+        rootNode->WinCount() += otherRoot->WinCount();
 
-            // Save new starting root
-            rootNode = newRoot;
-            newRoot->parent = nullptr;
+        for (int i = 0; i < otherRoot->children.Num(); i++) {
+            // Make sure our tree has this child too before adding to it.
+            while (rootNode->children.Num() <= i) {
+                if (!Expand(rootNode, nodePool, randomStreams[0], false))
+                    return;
+            }
+            rootNode->children[i]->SelectionCount() += otherRoot->children[i]->SelectionCount();
+            rootNode->children[i]->WinCount() += otherRoot->children[i]->WinCount();
         }
+    }
+
+    // Returns false if the move was never expanded, leaving the root where it was.
+    bool ValidateMove(FMCTSMove validMove) {
+        const FMCTSMoveId validMoveId = FMCTSMoveId::FromMove(validMove);
+        const int validChildIndex = rootNode ? rootNode->children.IndexOfByPredicate([validMoveId](const UMCTSNode* child) { return child->move == validMoveId; }) : INDEX_NONE;
+        if (validChildIndex != INDEX_NONE)
+            RerootTo(rootNode->children[validChildIndex]);
 
-        UE_LOG(LogTemp, Display, TEXT("\nStarting root at end of tree construction:\n%s"), *DebugNodeString(rootNode));
+        if (rootNode)
+            UE_LOG(LogTemp, Display, TEXT("\nStarting root at end of tree construction:\n%s"), *DebugNodeString(rootNode));
+        return validChildIndex != INDEX_NONE;
+    }
+
+    // newRoot can be any node below the root.
+    void RerootTo(UMCTSNode* newRoot) {
+        // Discard uneeded branches (the old root and everything not under newRoot go back to the pool in one step)
+        newRoot->DetachFromParentStats();
+        newRoot->parent->children.Remove(newRoot);
+        nodePool.Release(rootNode);
+
+        // Save new starting root
+        rootNode = newRoot;
+        newRoot->parent = nullptr;
+    }
+
+    static int64 CountNodes(const UMCTSNode* node) {
+        int64 count = 1;
+        for (const UMCTSNode* child : node->children)
+            count += CountNodes(child);
+        return count;
+    }
+
+    UMCTSNode* FindState(UMCTSNode* node, uint64 stateHash, int depthLeft) {
+        if (FMCTSStateHasher::Hash(node->state) == stateHash)
+            return node;
+        if (depthLeft <= 0)
+            return nullptr;
+
+        for (UMCTSNode* child : node->children) {
+            if (UMCTSNode* match = FindState(child, stateHash, depthLeft - 1))
+                return match;
+        }
+        return nullptr;
     }
 
     UMCTSNode* TraverseEpisode(UMCTSNode* node, TArray<FMCTSMove>& bestMoves) {
         int depth = 0;
         UE_LOG(LogTemp, Display, TEXT("******Starting Episode Playout***********"));
-        while (depth < maxSimulationDepth && !ruleSet->IsTerminalState(node->state)) {
-            TArray<FMCTSMove> moves = ruleSet->EnumerateMoves(node->state);
+        while (depth < maxSimulationDepth && !IsTerminal(node)) {
+            const FMCTSMoveList& moves = GetMoves(node);
             if (moves.IsEmpty())
                 break;
 
             UE_LOG(LogTemp, Display, TEXT("Move #%d: %s"), depth, *DebugNodeString(node));
 
-            // Find the move that leads to the best child
+            // Find the move that leads to the best child. A proven win beats any visit count, and a proven loss is
+            // only played when there's nothing else.
             int bestScore = -1;
+            int bestRank = -1;
             UMCTSNode* bestNode = nullptr;
             FMCTSMove bestMove;
-            for (FMCTSMove m : moves) {
-                FString moveKey = m.ToString();
-                if (!node->children.Contains(moveKey))
-                    break;
-
-                UMCTSNode* child = node->children[moveKey];
-                if (bestScore < child->selectionCount) {
-                    bestScore = child->selectionCount;
-                    bestMove = m;
+            for (int i = 0; i < moves.Num() && i < node->children.Num(); i++) {
+                UMCTSNode* child = node->children[i];
+                const EMCTSProof childProof = child->ProofForParent();
+                const int rank = childProof == EMCTSProof::Win ? 2 : (childProof == EMCTSProof::Loss ? 0 : 1);
+                if (rank > bestRank || (rank == bestRank && bestScore < child->SelectionCount())) {
+                    bestRank = rank;
+                    bestScore = child->SelectionCount();
+                    bestMove = moves[i].ToMove();
                     bestNode = child;
                 }
             }
@@ -347,89 +1755,82 @@ private:
     }
 
     FString DebugNodeString(UMCTSNode* n) {
-        auto moves = ruleSet->EnumerateMoves(n->state);
+        const FMCTSMoveList& moves = GetMoves(n);
+        const FMCTSSearchMonster& actingMonster = n->state.monsters[n->state.actingPlayerIndex];
 
-        FString ret = FString::Printf(TEXT("(%d/%d) - Turn %d. %d possible moves - Acting player: %i (@(%f,%f)) - AP left: %i.\n"), n->winCount, n->selectionCount, n->state.turnCount, moves.Num(), n->state.actingPlayerIndex, (n->state.monsterStates[n->state.actingPlayerIndex].position.X), (n->state.monsterStates[n->state.actingPlayerIndex].position.Y), n->state.monsterStates[n->state.actingPlayerIndex].ap);
+        FString ret = FString::Printf(TEXT("(%.1f/%d) - Turn %d. %d possible moves - Acting player: %i (@(%d,%d)) - AP left: %i.\n"), static_cast<float>(n->WinCount().load()) / FMCTSChildStats::WinScale, n->SelectionCount().load(), n->state.turnCount, moves.Num(), n->state.actingPlayerIndex, FMCTSSearchState::CellX(actingMonster.cell), FMCTSSearchState::CellY(actingMonster.cell), actingMonster.ap);
         
-        int i = 0;
-        for (FMCTSMove m : moves ) {
-            FString key = m.ToString();
-            ret += n->children.Contains(key) ? FString::Printf(TEXT("%d:(%d/%d)[%s],  "), i, n->children[key]->winCount, n->children[key]->selectionCount, *key) : FString::Printf(TEXT("%d:(x)[%s],  "),i,*key);
-            i++;
+        for (int i = 0; i < moves.Num(); i++) {
+            FString key = moves[i].ToMove().ToString();
+            ret += n->children.IsValidIndex(i) ? FString::Printf(TEXT("%d:(%.1f/%d)[%s],  "), i, static_cast<float>(n->children[i]->WinCount().load()) / FMCTSChildStats::WinScale, n->children[i]->SelectionCount().load(), *key) : FString::Printf(TEXT("%d:(x)[%s],  "),i,*key);
         }
         return ret;
     }
 
-    UMCTSNode* Expand(UMCTSNode* node) {
-        TArray<FMCTSMove> moves = ruleSet->EnumerateMoves(node->state);
-        for (const FMCTSMove& move : moves) {
-            if (!node->children.Contains(move.ToString())) {
-                FMCTSGameState nextState = ruleSet->NextState(node->state, move);
-                if (nextState.monsterStates.Num() < 2) {
-                    FString culpritString = move.ToString();
-                    UE_LOG(LogTemp, Error, TEXT("\nExpanded state empty! Culprit: %s"), *culpritString);
-                    return nullptr;
-                }
-                UMCTSNode* childNode = new UMCTSNode(nextState);
-                childNode->parent = node;
-                node->children.Add(move.ToString(), childNode);
-                return childNode;
-            }
+    // Expansion takes the node's own lock, so threads only ever wait on each other when expanding the same node.
+    UMCTSNode* Expand(UMCTSNode* node, TMCTSNodePool<UMCTSNode>& pool, FMCTSRandom& random, bool bShared) {
+        const FMCTSMoveList& moves = GetMoves(node);
+
+        node->LockExpansion();
+
+        // Children are added in enumeration order, so the first untried move is the next index.
+        const int untriedIndex = node->children.Num();
+        if (untriedIndex >= moves.Num()) {
+            node->UnlockExpansion();
+            return nullptr;
         }
-        return nullptr;
+
+        const FMCTSMoveId move = moves[untriedIndex];
+        UMCTSNode* childNode = bShared ? pool.AcquireThreadSafe() : pool.Acquire();
+        childNode->state = node->state;
+        if (transpositions.IsEnabled()) {
+            // The journal is only there to say which platforms the move touched, so the rehash can skip the rest.
+            FMCTSStateJournal journal;
+            ruleSet->ApplyMove(childNode->state, move, random, &journal);
+            childNode->hash = FMCTSStateHasher::Rehash(node->hash, node->state, childNode->state, journal.ChangedPlatforms());
+        }
+        else {
+            ruleSet->ApplyMove(childNode->state, move, random);
+        }
+        childNode->parent = node;
+        childNode->LinkToParentStats(node, untriedIndex);
+        childNode->move = move;
+        childNode->randomOutcome = ruleSet->HasRandomOutcome(node->state, move);
+        node->children.Add(childNode);
+        node->expandedChildren.store(node->children.Num(), std::memory_order_release);
+
+        node->UnlockExpansion();
+        return childNode;
     }
 
-    bool Simulate(UMCTSNode* node) {
-        FMCTSGameState currentState = node->state;
+    // Everything here lives on the stack, so a playout never allocates, and moves are applied to the one scratch state.
+    // Returns 1 for a win, 0 for a loss, or the evaluator's guess in between if the playout was cut off, all for the
+    // player to move at the node (see Update).
+    // playedMoves, if given, collects the moves the playout made up to the end of the first turn.
+    float Simulate(UMCTSNode* node, FMCTSRandom& random, FMCTSMoveSet* playedMoves = nullptr) {
+        FMCTSSearchState currentState = node->state;
         int depth = 0;
-        FMCTSGameState simmedState;
+        const int maxDepth = GetPlayoutDepth();
+        FMCTSMoveList moves;
         // UE_LOG(LogTemp, Display, TEXT("\n**************Starting a Simulation**********************"));
-        while (depth < maxSimulationDepth && !ruleSet->IsTerminalState(currentState)) {
-            TArray<FMCTSMove> moves = ruleSet->EnumerateMoves(currentState);
+        while (depth < maxDepth && !ruleSet->IsTerminalState(currentState)) {
+            ruleSet->EnumerateMoves(currentState, moves);
             if (moves.IsEmpty())
                 break;
 
             // Ideally, we use the trained model to evaluate the resulting state for each move, and choose the best.
-            /*
-            // GREEDY PLAYOUT POLICY
-            
-            int bestMoveIndex = -1;
-            float bestEvaluation = -500;
-            
-            for (int i = 0; i < moves.Num(); i++) {
-                // TArray<float> currentMoveEvaluations = model->Evaluate(currentState);
-                FMCTSGameState currentMoveResultingState = ruleSet->NextState(currentState, moves[i]);
-                float currentMoveEvaluation = currentMoveResultingState.monsterStates[currentState.actingPlayerIndex].score - currentMoveResultingState.monsterStates[1 - currentState.actingPlayerIndex].score;
-                if (currentMoveEvaluation > bestEvaluation) {
-                    bestEvaluation = currentMoveEvaluation;
-                    bestMoveIndex = i;
-                }
-            }
-            
-            if (bestMoveIndex < 0)
-                bestMoveIndex = FMath::RandRange(0, moves.Num()-1); // Traditional MCTS: Just run moves randomly during sim.
-            */
-
-            // RANDOM PLAYOUT POLICY
-            int bestMoveIndex = FMath::RandRange(0, moves.Num() - 1); // Traditional MCTS: Just run moves randomly during sim.
+            // Until then the policy picks, randomly by default (see FMCTSBattleGreedyPolicy for a greedy one).
+            int bestMoveIndex = TPolicy::ChoosePlayoutMove(*ruleSet, currentState, moves, random);
 
-            // FString sim = FString::Printf(TEXT("Turn %d. %d possible moves - Acting player: %i - AP left: %i.\n"), currentState.turnCount, moves.Num(), currentState.actingPlayerIndex, currentState.monsterStates[currentState.actingPlayerIndex].ap);
+            // FString sim = FString::Printf(TEXT("Turn %d. %d possible moves - Acting player: %i - AP left: %i.\n"), currentState.turnCount, moves.Num(), currentState.actingPlayerIndex, currentState.monsters[currentState.actingPlayerIndex].ap);
 
             // UE_LOG(LogTemp, Display, TEXT("\nSimulation Step %d: %s"), depth, *sim);
 
-            if (currentState.monsterStates.Num() < 2) {
-                UE_LOG(LogTemp, Error, TEXT("\nCurrent state empty before sim!"));
-                return false;
-            }
-
-            const FMCTSMove& selectedMove = moves[bestMoveIndex];
-            simmedState = ruleSet->NextState(currentState, selectedMove);
-            if (simmedState.monsterStates.Num() < 2) {
-                FString culpritString = selectedMove.ToString();
-                UE_LOG(LogTemp, Error, TEXT("\nSimulated state empty! Culprit: %s"), *culpritString);
-                return false;
-            }
-            currentState = simmedState;//ruleSet->NextState(currentState, selectedMove);
+            if (playedMoves)
+                playedMoves->Add(moves[bestMoveIndex]);
+            ruleSet->ApplyMove(currentState, moves[bestMoveIndex], random);
+            if (currentState.actingPlayerIndex != node->state.actingPlayerIndex)
+                playedMoves = nullptr;
             depth++;
         }
 
@@ -438,43 +1839,116 @@ private:
 
         // UE_LOG(LogTemp, Display, TEXT("\n*****************************Finished Simulation************************************"));
 
-        return ruleSet->EvaluateTerminalState(currentState, currentState.actingPlayerIndex);
+        const int scoredPlayerIndex = node->state.actingPlayerIndex;
+        if (playoutCutoff > 0 && !ruleSet->IsTerminalState(currentState))
+            return ruleSet->EvaluateState(currentState, scoredPlayerIndex);
+        return ruleSet->EvaluateTerminalState(currentState, scoredPlayerIndex) ? 1.0f : 0.0f;
     }
 
-    void Update(UMCTSNode* node, bool win) {
-        node->Update(win);
+    int GetPlayoutDepth() const {
+        return playoutCutoff > 0 ? FMath::Min(playoutCutoff, maxSimulationDepth) : maxSimulationDepth;
     }
 
-    UMCTSNode* Select(UMCTSNode* node, bool stopOnUnexplored = true) {
-        node->selectionCount++;
+    // Runs playoutBudget playouts from the node and returns how many were wins, in 1/FMCTSChildStats::WinScale
+    // playouts so the fractional wins of cut-off playouts survive even a batch of one.
+    // With parallel playouts each one gets its own RNG stream seeded from the calling thread's stream.
+    int32 SimulateBatch(UMCTSNode* node, FMCTSRandom& random) {
+        if (raveEquivalence > 0) {
+            float wins = 0.0f;
+            FMCTSMoveSet playedMoves;
+            for (int j = 0; j < playoutBudget; j++) {
+                playedMoves.Reset();
+                const float reward = Simulate(node, random, &playedMoves);
+                UpdateAmaf(node, reward, playedMoves);
+                wins += reward;
+            }
+            return FMath::RoundToInt(wins * FMCTSChildStats::WinScale);
+        }
+
+        if (!bParallelPlayouts || playoutBudget <= 1) {
+            float wins = 0.0f;
+            for (int j = 0; j < playoutBudget; j++)
+                wins += Simulate(node, random);
+            return FMath::RoundToInt(wins * FMCTSChildStats::WinScale);
+        }
+
+        const uint64 batchSeed = random.Next64();
+        TArray<float, TInlineAllocator<16>> rewards;
+        rewards.SetNumZeroed(playoutBudget);
+        ParallelFor(playoutBudget, [this, node, batchSeed, &rewards](int32 playoutIndex) {
+            FMCTSRandom playoutRandom(batchSeed, playoutIndex);
+            rewards[playoutIndex] = Simulate(node, playoutRandom);
+        });
+
+        float wins = 0.0f;
+        for (const float reward : rewards)
+            wins += reward;
+        return FMath::RoundToInt(wins * FMCTSChildStats::WinScale);
+    }
+
+    // Backs up a batch of playout results in one walk to the root, with the policy deciding how results carry over to
+    // each parent, also crediting each state's pooled entry when the transposition table is on.
+    // wins are in 1/FMCTSChildStats::WinScale playouts and always for the player to move at node: playouts (Simulate), proofs (ProvenWins) and the
+    // endgame solver all score from there, whoever ends up moving at the end of the game.
+    void Update(UMCTSNode* node, int32 wins, int32 playouts) {
+        const bool bPooled = transpositions.IsEnabled();
+        for (UMCTSNode* n = node; n; n = n->parent) {
+            if (wins > 0) {
+                n->WinCount().fetch_add(wins, std::memory_order_relaxed);
+                if (bPooled)
+                    transpositions.AddWins(n->hash, wins);
+            }
+            wins = TPolicy::WinsForParent(*n, wins, playouts);
+        }
+    }
+
+    // Credits one playout to the AMAF counts of every node from here to the root: each move a node could make counts
+    // if its player made it later in the same turn, in the tree or in the playout (playedMoves starts as the playout's
+    // first turn, see Simulate). reward is for the player to move here, as in Update, and is flipped to each child's
+    // player the same way its own wins are.
+    void UpdateAmaf(UMCTSNode* node, float reward, FMCTSMoveSet& playedMoves) {
+        for (UMCTSNode* n = node; n; n = n->parent) {
+            if (n->movesCached.load(std::memory_order_acquire)) {
+                FMCTSChildStats& stats = n->childStats;
+                const int32 numExpanded = n->NumExpandedChildren();
+                for (int32 childIndex = 0; childIndex < n->moves.Num(); childIndex++) {
+                    const FMCTSMoveId move = n->moves[childIndex];
+                    if (!playedMoves.Contains(move))
+                        continue;
+                    // Only end turn hands over to the other player, until the child exists to ask.
+                    const bool bOtherPlayer = childIndex < numExpanded
+                        ? n->GetChild(childIndex)->state.actingPlayerIndex != n->state.actingPlayerIndex
+                        : move.IsEndTurn();
+                    const float childReward = bOtherPlayer ? 1.0f - reward : reward;
+                    stats.amafVisits[childIndex].fetch_add(1, std::memory_order_relaxed);
+                    stats.amafWins[childIndex].fetch_add(FMath::RoundToInt(childReward * FMCTSChildStats::WinScale), std::memory_order_relaxed);
+                }
+            }
+            if (n->parent) {
+                // A move that hands over to the other player ends the parent's turn, so nothing after it counts.
+                if (n->parent->state.actingPlayerIndex != n->state.actingPlayerIndex) {
+                    playedMoves.Reset();
+                    reward = 1.0f - reward;
+                }
+                playedMoves.Add(n->move);
+            }
+        }
+    }
+
+    // pathVirtualLoss is added to every node on the way down (and taken off again after Update) so concurrent
+    // threads see the branch as already busy and spread out.
+    UMCTSNode* Select(UMCTSNode* node, bool stopOnUnexplored = true, int32 pathVirtualLoss = 0) {
+        VisitNode(node, pathVirtualLoss);
 
         // keep selecting until we get to a node w/ unexplored children OR a terminal node.
         int selectionDepth = 0;
-        while (selectionDepth < maxSimulationDepth && !ruleSet->IsTerminalState(node->state) && (!stopOnUnexplored || node->children.Num() == ruleSet->EnumerateMoves(node->state).Num())) {
+        while (selectionDepth < maxSimulationDepth && !IsTerminal(node) && !node->IsSolved() && (!stopOnUnexplored || node->IsFullyExpanded())) {
             selectionDepth++;
             // UE_LOG(LogTemp, Display, TEXT("\nIn Selection, Traversing:\n%s"), *DebugNodeString(node));
-            float UCB1Value = -1.0f;
-            UMCTSNode* selectedChild = nullptr;
-            FString UCBDebug = TEXT("UCB1 Scores: ");
-            for (const auto& pair : node->children) {
-                UMCTSNode* child = pair.Value;
-                float ucb1 = UCB1(child);
-
-                //disprefer idleness!
-                if (pair.Key.Mid(8, 1).Equals(TEXT("-"))) {
-                    ucb1 = -0.5f;
-                }
-
-                if (ucb1 > UCB1Value) {
-                    UCB1Value = ucb1;
-                    selectedChild = child;
-                }
-                UCBDebug += FString::Printf(TEXT("%f "), ucb1);
-            }
-            // UE_LOG(LogTemp, Display, TEXT("\n%s"), *UCBDebug);
+            UMCTSNode* selectedChild = SelectChild(node);
             if (selectedChild) {
                 node = selectedChild;
-                node->selectionCount++;
+                VisitNode(node, pathVirtualLoss);
             }
             else {
                 UE_LOG(LogTemp, Warning, TEXT("Failed to select a child in this node:\n%s"), *DebugNodeString(node));
@@ -482,30 +1956,151 @@ private:
             }
         }
 
-        //if we happen upon a terminal node, set it AND its parent's score to extremes?
-        if (ruleSet->IsTerminalState(node->state)) {
-            // UE_LOG(LogTemp, Warning, TEXT("\n[BUG] Selected a terminal node. Infinite wins here!"));
-            if (ruleSet->EvaluateTerminalState(node->state, node->state.actingPlayerIndex)) {
-                UMCTSNode* updatingNode = node;
-                while (updatingNode && updatingNode->state.actingPlayerIndex == node->state.actingPlayerIndex) {
-                    updatingNode->winCount = FP_INFINITE;
-                    updatingNode->selectionCount = FP_INFINITE;
-                    if (updatingNode->parent && updatingNode->parent->state.actingPlayerIndex != node->state.actingPlayerIndex)
-                        node->parent->winCount = -FP_INFINITE;
-                    updatingNode = updatingNode->parent;
+        // Terminal nodes are normally solved when they're expanded, this catches any that weren't.
+        if (IsTerminal(node))
+            Solve(node);
+
+        return node;
+    }
+
+    // Proves a terminal node from the rules.
+    void Solve(UMCTSNode* node) {
+        const int actingPlayerIndex = node->state.actingPlayerIndex;
+        EMCTSProof proof = EMCTSProof::Draw;
+        if (ruleSet->EvaluateTerminalState(node->state, actingPlayerIndex))
+            proof = EMCTSProof::Win;
+        else if (ruleSet->EvaluateTerminalState(node->state, 1 - actingPlayerIndex))
+            proof = EMCTSProof::Loss;
+        Prove(node, proof);
+    }
+
+    // Stands in for the node's playouts when it's close enough to the end for the endgame solver. outWins is the
+    // solved value scaled to playoutBudget (in WinScale units, as SimulateBatch), and an exact value proves the node as well. False means run playouts.
+    bool SolveEndgame(UMCTSNode* node, FMCTSRandom& random, int32& outWins) {
+        if (endgameTurns <= 0)
+            return false;
+        const int32 turnsRemaining = ruleSet->TurnsRemaining(node->state);
+        if (turnsRemaining < 0 || turnsRemaining > endgameTurns)
+            return false;
+
+        float value;
+        bool bExact;
+        if (!endgameSolver.Solve(*ruleSet, node->state, random, value, bExact))
+            return false;
+
+        if (bExact)
+            Prove(node, value >= 1.0f ? EMCTSProof::Win : value <= 0.0f ? EMCTSProof::Loss : EMCTSProof::Draw);
+        outWins = FMath::RoundToInt(value * playoutBudget * FMCTSChildStats::WinScale);
+        return true;
+    }
+
+    // Sets the node's proof, then carries it up for as long as it settles the parent too.
+    void Prove(UMCTSNode* node, EMCTSProof proof) {
+        if (!node->SetProof(proof))
+            return;
+
+        for (UMCTSNode* ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+            const EMCTSProof ancestorProof = ancestor->SolveFromChildren();
+            if (ancestorProof == EMCTSProof::Unknown || !ancestor->SetProof(ancestorProof))
+                break;
+        }
+    }
+
+    // What every playout from a solved node would come back as, for the player to move there, in WinScale units.
+    static int32 ProvenWins(const UMCTSNode* node, int32 playouts) {
+        switch (node->GetProof()) {
+        case EMCTSProof::Win:
+            return playouts * FMCTSChildStats::WinScale;
+        case EMCTSProof::Draw:
+            return playouts * FMCTSChildStats::WinScale / 2;
+        default:
+            return 0;
+        }
+    }
+
+    void VisitNode(UMCTSNode* node, int32 pathVirtualLoss) {
+        const int32 ownVisits = node->SelectionCount().fetch_add(1, std::memory_order_relaxed);
+        if (pathVirtualLoss > 0)
+            node->VirtualLoss().fetch_add(pathVirtualLoss, std::memory_order_relaxed);
+
+        if (transpositions.IsEnabled()) {
+            transpositions.Probe(node->hash, ownVisits);
+            transpositions.AddVisit(node->hash);
+        }
+    }
+
+    // Scores every unsolved expanded child with TPolicy::ScoreChildren and returns the best (the first on ties), or
+    // nullptr if none scores above -1.
+    // Pending virtual loss counts as visits that haven't won (yet).
+    // With the transposition table on, a state's pooled counts are used when they cover more visits than the node's own.
+    // With RAVE on, each child's wins are blended towards its AMAF rate by beta = sqrt(k / (3n + k)) before scoring.
+    UMCTSNode* SelectChild(UMCTSNode* node) {
+        const int32 numChildren = node->NumExpandedChildren();
+        const int32 paddedChildren = (numChildren + 3) & ~3;
+        TArray<float, TInlineAllocator<64>> wins, visits, priors, scores;
+        wins.SetNumUninitialized(paddedChildren);
+        visits.SetNumUninitialized(paddedChildren);
+        priors.SetNumUninitialized(paddedChildren);
+        scores.SetNumUninitialized(paddedChildren);
+
+        const FMCTSChildStats& stats = node->childStats;
+        const bool bPooled = transpositions.IsEnabled();
+        for (int32 childIndex = 0; childIndex < numChildren; childIndex++) {
+            int32 ownVisits = stats.visits[childIndex].load(std::memory_order_relaxed);
+            int32 ownWins = stats.wins[childIndex].load(std::memory_order_relaxed);
+            if (bPooled) {
+                if (const FMCTSTranspositionEntry* entry = transpositions.Find(node->GetChild(childIndex)->hash)) {
+                    const int32 pooledVisits = entry->visits.load(std::memory_order_relaxed);
+                    if (pooledVisits > ownVisits) {
+                        ownVisits = pooledVisits;
+                        ownWins = entry->wins.load(std::memory_order_relaxed);
+                    }
                 }
             }
+            visits[childIndex] = static_cast<float>(ownVisits + stats.virtualLoss[childIndex].load(std::memory_order_relaxed));
+            wins[childIndex] = static_cast<float>(ownWins) / FMCTSChildStats::WinScale;
+            if (raveEquivalence > 0) {
+                const int32 amafVisits = stats.amafVisits[childIndex].load(std::memory_order_relaxed);
+                if (amafVisits > 0) {
+                    // AMAF counts single playouts, the node counts batches of playoutBudget.
+                    const float amafRate = static_cast<float>(stats.amafWins[childIndex].load(std::memory_order_relaxed)) * playoutBudget / (static_cast<float>(amafVisits) * FMCTSChildStats::WinScale);
+                    const float beta = std::sqrt(raveEquivalence / (3.0f * ownVisits + raveEquivalence));
+                    wins[childIndex] = (1.0f - beta) * wins[childIndex] + beta * amafRate * visits[childIndex];
+                }
+            }
+            priors[childIndex] = stats.priors[childIndex];
+        }
+        for (int32 childIndex = numChildren; childIndex < paddedChildren; childIndex++) {
+            visits[childIndex] = 1.0f;
+            wins[childIndex] = 0.0f;
+            priors[childIndex] = 0.0f;
+        }
+
+        const int32 parentVisits = node->SelectionCount().load(std::memory_order_relaxed) + node->VirtualLoss().load(std::memory_order_relaxed);
+        TPolicy::ScoreChildren(wins.GetData(), visits.GetData(), priors.GetData(), paddedChildren, parentVisits, scores.GetData());
+        for (int32 childIndex = numChildren; childIndex < paddedChildren; childIndex++)
+            scores[childIndex] = -std::numeric_limits<float>::infinity();
+        // Solved children have nothing left to search (and a winning one would have solved this node already).
+        for (int32 childIndex = 0; childIndex < numChildren; childIndex++) {
+            if (node->GetChild(childIndex)->ProofForParent() != EMCTSProof::Unknown)
+                scores[childIndex] = -std::numeric_limits<float>::infinity();
         }
-        
-        return node;
-    }
 
-    float UCB1(UMCTSNode* node) {
-        if (node->selectionCount <= 0)
-            return std::numeric_limits<float>::infinity();
-        float exploitation = static_cast<float>(node->winCount) / node->selectionCount;
-        float exploration = 2 * std::sqrt(std::log(static_cast<float>(node->parent->selectionCount)) / node->selectionCount);
-        return exploitation + exploration;
+        // Vector max, then the first child that has it.
+        VectorRegister4Float bestScores = VectorSetFloat1(-1.0f);
+        for (int32 childIndex = 0; childIndex < paddedChildren; childIndex += 4)
+            bestScores = VectorMax(bestScores, VectorLoad(scores.GetData() + childIndex));
+        alignas(16) float bestLanes[4];
+        VectorStoreAligned(bestScores, bestLanes);
+        const float bestScore = FMath::Max(FMath::Max(bestLanes[0], bestLanes[1]), FMath::Max(bestLanes[2], bestLanes[3]));
+        if (!(bestScore > -1.0f))
+            return nullptr;
+
+        for (int32 childIndex = 0; childIndex < numChildren; childIndex++) {
+            if (scores[childIndex] == bestScore)
+                return node->GetChild(childIndex);
+        }
+        return nullptr;
     }
 
     int playerIndex;
@@ -515,4 +2110,39 @@ private:
 
     // Saved decision tree, used for follow-up decisions.
     UMCTSNode* rootNode;
-};
\ No newline at end of file
+
+    // Every node in the tree comes from here.
+    TMCTSNodePool<UMCTSNode> nodePool;
+
+    EMCTSParallelMode parallelMode;
+    int32 searchThreads;
+    int32 virtualLossPerThread;
+    bool bParallelPlayouts;
+    bool bCollapseEquivalentMoves;
+    int32 endgameTurns = 0;
+    int32 playoutCutoff = 0;
+    int32 raveEquivalence = 0;
+    int32 seed;
+    TArray<FMCTSRandom> randomStreams; // One per search thread.
+    TArray<TUniquePtr<FMCTSRootWorker>> rootWorkers;
+
+    // Shared by every thread and kept across decisions, since a state's statistics stay valid after re-rooting.
+    FMCTSTranspositionTable transpositions;
+    TMCTSEndgameSolver<TRuleSet> endgameSolver; // Shared by every thread, like the table above.
+    int64 totalIterations = 0;
+    int64 lastSearchIterations = 0;
+
+    float timeBudgetMs = 0.0f;
+    double searchDeadline = 0.0; // FPlatformTime::Seconds() to stop at, 0 when searching by iteration count.
+
+    // Progress of a BeginSearch/StepSearch/FinishSearch decision.
+    int64 slicedIterations = 0;
+    double slicedSearchDeadline = 0.0;
+    bool bSlicedSearchValid = false;
+    bool bSlicedSearchDone = true;
+
+    int64 ponderNodeLimit = 200000;
+};
+
+// Searches any IMCTSSearchRuleSet through its virtual interface.
+typedef TMCTSAgent<IMCTSSearchRuleSet> UMCTSAgent;
\ No newline at end of file
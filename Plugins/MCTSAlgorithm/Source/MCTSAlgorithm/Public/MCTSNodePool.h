@@ -0,0 +1,115 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeLock.h"
+
+// Counters for the node pool. Log these after a stress run to check the allocator is behaving.
+struct FMCTSNodePoolStats {
+    int64 slabsAllocated = 0;   // Slabs of fresh memory requested from the system allocator.
+    int64 nodesAcquired = 0;    // Total nodes handed out.
+    int64 nodesRecycled = 0;    // Nodes handed out from released subtrees instead of untouched slab memory.
+    int64 subtreesReleased = 0; // Calls to Release(), each returning a whole subtree in one step.
+    int64 bulkResets = 0;       // Calls to ReleaseAll().
+    int64 liveNodes = 0;        // Nodes handed out and not yet back on the free list (children of a released subtree count until its root is reused).
+    int64 peakLiveNodes = 0;
+};
+
+// Slab pool for search tree nodes.
+// Nodes are carved from fixed-size slabs and never handed back to the system allocator until the pool dies.
+// Releasing a subtree is O(1): its root is pushed on a free list, and its children only get pushed in turn
+// when that root is reused, so the teardown cost is spread over later allocations.
+// NodeType needs a default constructor, a Reset() that clears it for reuse (keeping any capacity), a parent
+// pointer (used as the free list link while released) and a ForEachChild(Func) visitor.
+template<typename NodeType>
+class TMCTSNodePool {
+public:
+    explicit TMCTSNodePool(int32 _slabSize = 1024) : slabSize(FMath::Max(_slabSize, 1)), nextSlot(0), constructedSlots(0), freeList(nullptr) {}
+
+    TMCTSNodePool(const TMCTSNodePool&) = delete;
+    TMCTSNodePool& operator=(const TMCTSNodePool&) = delete;
+
+    ~TMCTSNodePool() {
+        for (int64 slot = 0; slot < constructedSlots; slot++)
+            SlotAt(slot)->~NodeType();
+        for (NodeType* slab : slabs)
+            FMemory::Free(slab);
+    }
+
+    NodeType* Acquire() {
+        NodeType* node = nullptr;
+
+        if (freeList) {
+            node = freeList;
+            freeList = node->parent;
+
+            // Lazily hand the children of the recycled node back to the free list.
+            node->ForEachChild([this](NodeType* child) { PushFree(child); });
+            node->Reset();
+            stats.nodesRecycled++;
+        }
+        else {
+            const int64 slot = nextSlot++;
+            if (slot / slabSize >= slabs.Num()) {
+                slabs.Add(static_cast<NodeType*>(FMemory::Malloc(sizeof(NodeType) * slabSize, alignof(NodeType))));
+                stats.slabsAllocated++;
+            }
+
+            node = SlotAt(slot);
+            if (slot >= constructedSlots) {
+                new (node) NodeType();
+                constructedSlots++;
+            }
+            else {
+                node->Reset();
+            }
+        }
+
+        stats.nodesAcquired++;
+        stats.liveNodes++;
+        stats.peakLiveNodes = FMath::Max(stats.peakLiveNodes, stats.liveNodes);
+        return node;
+    }
+
+    // Same as Acquire, for when several search threads grow one tree.
+    NodeType* AcquireThreadSafe() {
+        FScopeLock lock(&acquireLock);
+        return Acquire();
+    }
+
+    // Gives back a node and everything below it.
+    void Release(NodeType* subtreeRoot) {
+        if (!subtreeRoot)
+            return;
+        PushFree(subtreeRoot);
+        stats.subtreesReleased++;
+    }
+
+    // Gives back every node at once. Constructed slots are kept around and reset on reuse.
+    void ReleaseAll() {
+        freeList = nullptr;
+        nextSlot = 0;
+        stats.liveNodes = 0;
+        stats.bulkResets++;
+    }
+
+    const FMCTSNodePoolStats& GetStats() const { return stats; }
+
+private:
+    NodeType* SlotAt(int64 slot) const {
+        return slabs[slot / slabSize] + (slot % slabSize);
+    }
+
+    void PushFree(NodeType* node) {
+        node->parent = freeList;
+        freeList = node;
+        stats.liveNodes--;
+    }
+
+    int32 slabSize;
+    TArray<NodeType*> slabs;
+    int64 nextSlot;         // Next untouched slot across all slabs.
+    int64 constructedSlots; // Slots below this have a live NodeType in them (may be reset on reuse).
+    NodeType* freeList;
+    FMCTSNodePoolStats stats;
+    FCriticalSection acquireLock;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// xoshiro128** generator for the search and the rules it plays out.
+// Each search thread and parallel playout owns one, so nothing is shared between threads, and a fixed
+// seed replays the same sequence on every machine (unlike FMath::Rand, whose stream is global).
+// Not thread-safe: hand every thread its own stream (see the stream constructor).
+struct FMCTSRandom {
+    FMCTSRandom() : FMCTSRandom(0) {}
+
+    // Streams with the same seed and a different index are independent, e.g. one per search thread.
+    explicit FMCTSRandom(uint64 seed, uint64 stream = 0) {
+        uint64 mix = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        for (int32 word = 0; word < 4; word += 2) {
+            const uint64 bits = SplitMix64(mix);
+            s[word] = static_cast<uint32>(bits);
+            s[word + 1] = static_cast<uint32>(bits >> 32);
+        }
+        // All zero is the one state xoshiro can't leave.
+        if ((s[0] | s[1] | s[2] | s[3]) == 0)
+            s[0] = 1;
+    }
+
+    uint32 Next() {
+        const uint32 result = Rotl(s[1] * 5, 7) * 9;
+        const uint32 t = s[1] << 9;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = Rotl(s[3], 11);
+        return result;
+    }
+
+    uint64 Next64() {
+        const uint64 high = Next();
+        return high << 32 | Next();
+    }
+
+    // Inclusive on both ends, like FRandomStream::RandRange. Uses a multiply rather than a modulo.
+    int32 RandRange(int32 min, int32 max) {
+        const uint64 range = static_cast<uint64>(static_cast<int64>(max) - min + 1);
+        return max <= min ? min : min + static_cast<int32>((Next() * range) >> 32);
+    }
+
+    // [0, 1)
+    float FRand() {
+        return (Next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    static uint32 Rotl(uint32 x, int32 k) {
+        return (x << k) | (x >> (32 - k));
+    }
+
+    static uint64 SplitMix64(uint64& state) {
+        uint64 z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint32 s[4];
+};
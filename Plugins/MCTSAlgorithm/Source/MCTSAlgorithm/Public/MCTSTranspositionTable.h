@@ -0,0 +1,104 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+// Snapshot of the table's counters, for the agent's stats.
+struct FMCTSTranspositionStats {
+    int64 probes = 0;       // Lookups made while descending the tree.
+    int64 hits = 0;         // Lookups that found statistics pooled from another path to the same state.
+    int64 stores = 0;       // Visits recorded into the table.
+    int64 replacements = 0; // Slots taken over from a different state.
+
+    float HitRate() const { return probes > 0 ? static_cast<float>(hits) / probes : 0.0f; }
+};
+
+// Pooled visit/win counts for one game state, wins in the same fixed-point units as the nodes' (FMCTSChildStats::WinScale).
+struct FMCTSTranspositionEntry {
+    std::atomic<uint64> key{ 0 };
+    std::atomic<int32> visits{ 0 };
+    std::atomic<int32> wins{ 0 };
+};
+
+// Bounded, direct-mapped table of statistics keyed by state hash.
+// Nodes reached by different move orders share an entry, so the tree searches them like a DAG without
+// sharing ownership of the nodes themselves. A new state simply takes over a slot held by another one.
+// Safe to use from several search threads; races only ever cost a few counts.
+class FMCTSTranspositionTable {
+public:
+    FMCTSTranspositionTable() : mask(0) {}
+
+    // sizeLog2 <= 0 turns the table off.
+    void Resize(int32 sizeLog2) {
+        entries.Reset();
+        mask = 0;
+        if (sizeLog2 > 0) {
+            const uint64 size = uint64(1) << FMath::Min(sizeLog2, 30);
+            entries = MakeUnique<FMCTSTranspositionEntry[]>(size);
+            mask = size - 1;
+        }
+        ResetStats();
+    }
+
+    bool IsEnabled() const { return entries.IsValid(); }
+
+    const FMCTSTranspositionEntry* Find(uint64 key) const {
+        const FMCTSTranspositionEntry& entry = entries[key & mask];
+        return entry.key.load(std::memory_order_relaxed) == key ? &entry : nullptr;
+    }
+
+    // Counted lookup, used once per node on the way down. ownVisits are the node's own visits, so a hit means the
+    // entry holds more than this node could have put there.
+    const FMCTSTranspositionEntry* Probe(uint64 key, int32 ownVisits) {
+        const FMCTSTranspositionEntry* entry = Find(key);
+        probes.fetch_add(1, std::memory_order_relaxed);
+        if (entry && entry->visits.load(std::memory_order_relaxed) > ownVisits)
+            hits.fetch_add(1, std::memory_order_relaxed);
+        return entry;
+    }
+
+    void AddVisit(uint64 key) {
+        FMCTSTranspositionEntry& entry = entries[key & mask];
+        const uint64 heldKey = entry.key.load(std::memory_order_relaxed);
+        if (heldKey != key) {
+            if (heldKey != 0)
+                replacements.fetch_add(1, std::memory_order_relaxed);
+            entry.key.store(key, std::memory_order_relaxed);
+            entry.visits.store(0, std::memory_order_relaxed);
+            entry.wins.store(0, std::memory_order_relaxed);
+        }
+        entry.visits.fetch_add(1, std::memory_order_relaxed);
+        stores.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Wins only land if the state still owns its slot.
+    void AddWins(uint64 key, int32 wins) {
+        FMCTSTranspositionEntry& entry = entries[key & mask];
+        if (wins > 0 && entry.key.load(std::memory_order_relaxed) == key)
+            entry.wins.fetch_add(wins, std::memory_order_relaxed);
+    }
+
+    FMCTSTranspositionStats GetStats() const {
+        FMCTSTranspositionStats stats;
+        stats.probes = probes.load();
+        stats.hits = hits.load();
+        stats.stores = stores.load();
+        stats.replacements = replacements.load();
+        return stats;
+    }
+
+    void ResetStats() {
+        probes.store(0);
+        hits.store(0);
+        stores.store(0);
+        replacements.store(0);
+    }
+
+private:
+    TUniquePtr<FMCTSTranspositionEntry[]> entries;
+    uint64 mask;
+    std::atomic<int64> probes{ 0 };
+    std::atomic<int64> hits{ 0 };
+    std::atomic<int64> stores{ 0 };
+    std::atomic<int64> replacements{ 0 };
+};
@@ -2,219 +2,317 @@
 #include "Math/Vector2D.h"
 #include "GenericPlatform/GenericPlatformMath.h"
 
+// Targeting lookups for every cell of the 3x3 arena, worked out once.
+// Steps off the edge of the board clamp back onto it, as ClampAxes(0, 2) used to.
+struct FMCTSBoardTables
+{
+	// (dx, dy), in the order the random and all-adjacent selectors have always tried them.
+	static constexpr int Directions[4][2] = { {1,0}, {0,1}, {-1,0}, {0,-1} };
+
+	uint8 step[9][4];        // Neighbour in each direction, or the cell itself at the edge.
+	uint16 adjacentMask[9];  // Every neighbour, never the cell itself.
+	uint8 rayStep[9][9][2];  // [own][target]: the next two cells past target, heading away from own (Line2/Line3).
+
+	FMCTSBoardTables()
+	{
+		for (uint8 cell = 0; cell < 9; cell++) {
+			const int x = FMCTSSearchState::CellX(cell);
+			const int y = FMCTSSearchState::CellY(cell);
+
+			adjacentMask[cell] = 0;
+			for (int direction = 0; direction < 4; direction++) {
+				step[cell][direction] = FMCTSSearchState::MakeCell(x + Directions[direction][0], y + Directions[direction][1]);
+				if (step[cell][direction] != cell)
+					adjacentMask[cell] |= FMCTSSearchState::CellBit(step[cell][direction]);
+			}
+
+			for (uint8 target = 0; target < 9; target++) {
+				const int directionX = FMCTSSearchState::CellX(target) - x;
+				const int directionY = FMCTSSearchState::CellY(target) - y;
+				const uint8 newPoint = FMCTSSearchState::MakeCell(FMCTSSearchState::CellX(target) + directionX, FMCTSSearchState::CellY(target) + directionY);
+				rayStep[cell][target][0] = newPoint;
+				rayStep[cell][target][1] = FMCTSSearchState::MakeCell(FMCTSSearchState::CellX(newPoint) + directionX, FMCTSSearchState::CellY(newPoint) + directionY);
+			}
+		}
+	}
+
+	static const FMCTSBoardTables& Get()
+	{
+		static const FMCTSBoardTables tables;
+		return tables;
+	}
+};
+
+// Calls func(cell) for each cell on the board, lowest first.
+template<typename Func>
+static void ForEachCell(uint16 board, Func func)
+{
+	while (board) {
+		func(static_cast<uint8>(FMath::CountTrailingZeros(static_cast<uint32>(board))));
+		board &= board - 1;
+	}
+}
+
+static bool IsGateOrStore(EGeneratedMoveEffectTypes type)
+{
+	switch (type) {
+		case EGeneratedMoveEffectTypes::StoreTemp:
+		case EGeneratedMoveEffectTypes::StoreHum:
+		case EGeneratedMoveEffectTypes::StoreElev:
+		case EGeneratedMoveEffectTypes::GateTemp:
+		case EGeneratedMoveEffectTypes::GateHum:
+		case EGeneratedMoveEffectTypes::GateElev:
+			return true;
+		default:
+			return false;
+	}
+}
+
+static bool IsRandomSelector(EGeneratedMoveTargetSelectorTypes selector)
+{
+	return selector == EGeneratedMoveTargetSelectorTypes::RandomAny ||
+		selector == EGeneratedMoveTargetSelectorTypes::RandomOccupied ||
+		selector == EGeneratedMoveTargetSelectorTypes::RandomAdjacent;
+}
+
+static float GetPlatformCondition(const FMCTSSearchPlatform& platform, uint8 condition)
+{
+	return condition == 0 ? platform.temp : (condition == 1 ? platform.hum : platform.elev);
+}
+
+static bool GateHolds(const FMCTSSearchPlatform& platform, uint8 condition, float power)
+{
+	const float value = GetPlatformCondition(platform, condition);
+	return power < 0 ? value >= -power : value <= power;
+}
+
 void FMCTSBattleRuleset::IngestMoveSets(TArray<FGeneratedMove> _playerMoveList, TArray<FGeneratedMove> _opponentMoveList, TArray<FGeneratedMove> _systemMoveList)
 {
-	playerMoveList = _playerMoveList;
-	opponentMoveList = _opponentMoveList;
-	systemMoveList = _systemMoveList;
+	playerMoveList.Reset();
+	opponentMoveList.Reset();
+	systemMoveList.Reset();
+	effectLists.Reset();
+	program.Reset();
+
+	CompileMoveList(_playerMoveList, playerMoveList);
+	CompileMoveList(_opponentMoveList, opponentMoveList);
+	CompileMoveList(_systemMoveList, systemMoveList);
+	CompileReactions();
 }
 
-void FMCTSBattleRuleset::ApplyPlatformStatusTriggersToState(const int castersIndex, const FMCTSMove& move, FMCTSGameState& inputState, bool& overrideJump)
+void FMCTSBattleRuleset::CompileMoveList(const TArray<FGeneratedMove>& moveList, TArray<FMCTSCompiledMove>& outMoves)
+{
+	for (const FGeneratedMove& move : moveList) {
+		FMCTSCompiledMove compiledMove;
+		compiledMove.firstList = effectLists.Num();
+		compiledMove.numLists = move.selectors.Num();
+		compiledMove.cost = move.cost;
+
+		for (int selectorIndex = 0; selectorIndex < move.selectors.Num(); selectorIndex++) {
+			FMCTSCompiledEffectList compiledList;
+			compiledList.selector = move.selectors[selectorIndex];
+			compiledList.firstInstruction = program.Num();
+
+			if (move.effectLists.IsValidIndex(selectorIndex))
+				CompileEffectList(move.effectLists[selectorIndex].effects);
+
+			compiledList.numInstructions = program.Num() - compiledList.firstInstruction;
+			for (int instructionIndex = compiledList.firstInstruction; instructionIndex < program.Num(); instructionIndex++) {
+				const EGeneratedMoveEffectTypes type = program[instructionIndex].type;
+				compiledList.bMovesMonsters |= type == EGeneratedMoveEffectTypes::MoveTo || type == EGeneratedMoveEffectTypes::PullPush;
+			}
+			effectLists.Add(compiledList);
+		}
+
+		outMoves.Add(compiledMove);
+	}
+}
+
+// A Gate or Store only ever affects the effect right after it, so when nothing can be pending on the Gate/Store
+// itself (the effect before it isn't a Gate or Store) and the next effect is a plain one, the pair becomes one
+// instruction. Anything else is kept as-is and runs through the same pending-flag logic as before.
+void FMCTSBattleRuleset::CompileEffectList(const TArray<FGeneratedEffect>& effects)
+{
+	for (int effectIndex = 0; effectIndex < effects.Num(); effectIndex++) {
+		const FGeneratedEffect& effect = effects[effectIndex];
+
+		FMCTSEffectInstruction instruction;
+		instruction.type = effect.type;
+		instruction.prefix = EMCTSEffectPrefix::None;
+		instruction.prefixCondition = 0;
+		instruction.power = effect.power / 100.0f;
+		instruction.prefixPower = 0.0f;
+
+		const bool bNothingPending = effectIndex == 0 || !IsGateOrStore(effects[effectIndex - 1].type);
+		const bool bFusesWithNext = effects.IsValidIndex(effectIndex + 1) && !IsGateOrStore(effects[effectIndex + 1].type);
+		if (IsGateOrStore(effect.type) && bNothingPending && bFusesWithNext) {
+			const FGeneratedEffect& nextEffect = effects[effectIndex + 1];
+			const uint8 effectType = static_cast<uint8>(effect.type);
+			const bool bIsGate = effect.type >= EGeneratedMoveEffectTypes::GateTemp;
+
+			instruction.type = nextEffect.type;
+			instruction.prefix = bIsGate ? EMCTSEffectPrefix::Gate : EMCTSEffectPrefix::Store;
+			instruction.prefixCondition = bIsGate ?
+				effectType - static_cast<uint8>(EGeneratedMoveEffectTypes::GateTemp) :
+				effectType - static_cast<uint8>(EGeneratedMoveEffectTypes::StoreTemp);
+			instruction.power = nextEffect.power / 100.0f;
+			instruction.prefixPower = effect.power / 100.0f;
+			effectIndex++;
+		}
+
+		program.Add(instruction);
+	}
+}
+
+void FMCTSBattleRuleset::ApplyPlatformStatusTriggersToState(const int castersIndex, FMCTSMoveId move, FMCTSSearchState& inputState, FMCTSRandom& random, FMCTSStateJournal* journal, bool& overrideJump)
 {
 	overrideJump = false;
 
 	// make sure move is a jump
-	if (move.moveIndex != 0) {
+	if (move.GetMoveIndex() != 0) {
 		return;
 	}
 
 	// get platform indeces for jump off and landing platforms
-	TArray<FVector2D> platformCoordinatesArray = {
-		FVector2D(0,0), FVector2D(0,1), FVector2D(0,2),
-		FVector2D(1,0), FVector2D(1,1), FVector2D(1,2),
-		FVector2D(2,0), FVector2D(2,1), FVector2D(2,2)
-	};
-
-	int jumpPlatformIndex = platformCoordinatesArray.Find(inputState.monsterStates[castersIndex].position);
-	FVector2D jumpTarget = move.targets[0].target;
-	int landPlatformIndex = platformCoordinatesArray.Find(jumpTarget);
+	int jumpPlatformIndex = inputState.monsters[castersIndex].cell;
+	uint8 jumpTarget = static_cast<uint8>(move.GetTargetCell());
+	int landPlatformIndex = jumpTarget;
 
 	// check statuses on the jump off platform
-	for (EMCTSPlatformStatusTypes status : inputState.platformStates[jumpPlatformIndex].statuses) {
-		switch (status) {
-			case EMCTSPlatformStatusTypes::Sandtrap:
-				overrideJump = true;
-				return;
-		}
+	if (inputState.platforms[jumpPlatformIndex].HasStatus(EMCTSPlatformStatusTypes::Sandtrap)) {
+		overrideJump = true;
+		return;
 	}
 
-	// check statuses on the landing platform
-	TArray<FMCTSMove> additionalMoves = {};
-	for (EMCTSPlatformStatusTypes status : inputState.platformStates[landPlatformIndex].statuses) {
+	// check statuses on the landing platform, in the order they were added (the list as it was before any of them react)
+	const FMCTSSearchPlatform landingPlatform = inputState.platforms[landPlatformIndex];
+	landingPlatform.ForEachStatus([&](EMCTSPlatformStatusTypes status) {
+		// slip, stamp, splash
+		int reactionIndex = INDEX_NONE;
 		switch (status) {
-			case EMCTSPlatformStatusTypes::Freeze: {
-				FMCTSMove slip = FMCTSMove(castersIndex);
-				slip.targets = { FMCTSMoveTargetingData(0, jumpTarget) };
-				slip.moveIndex = -2;
-				additionalMoves.Add(slip);
+			case EMCTSPlatformStatusTypes::Freeze:
+				reactionIndex = 0;
 				break;
-			}
-			case EMCTSPlatformStatusTypes::Ignite: {
-				FMCTSMove stamp = FMCTSMove(castersIndex);
-				stamp.targets = { FMCTSMoveTargetingData(0, jumpTarget) };
-				stamp.moveIndex = -3;
-				additionalMoves.Add(stamp);
+			case EMCTSPlatformStatusTypes::Ignite:
+				reactionIndex = 1;
 				break;
-			}
-			case EMCTSPlatformStatusTypes::Flood: {
-				FMCTSMove splash = FMCTSMove(castersIndex);
-				splash.targets = { FMCTSMoveTargetingData(0, jumpTarget) };
-				splash.moveIndex = -4;
-				additionalMoves.Add(splash);
+			case EMCTSPlatformStatusTypes::Flood:
+				reactionIndex = 2;
 				break;
-			}
 		}
-	}
+		if (reactionIndex == INDEX_NONE)
+			return;
 
-	for (auto m : additionalMoves) {
-		inputState = NextState(inputState, m);
-	}
+		if (bInlineReactions) {
+			if (reactionIndex < reactions.Num())
+				ApplyReaction(reactions[reactionIndex], castersIndex, jumpTarget, inputState, random, journal);
+		}
+		else {
+			ApplyMoveInPlace(inputState, FMCTSMoveId::Make(castersIndex, -2 - reactionIndex, 0, jumpTarget, 0), random, journal);
+		}
+	});
 }
 
-TArray<FMCTSMoveTargetingData> FillMoveTargets(const TArray<FMCTSMoveTargetingData> targets, const TArray<EGeneratedMoveTargetSelectorTypes> selectors, const FVector2D ownPosition, const FVector2D opponentPosition)
+void FillMoveTargets(const FMCTSMoveId move, const EGeneratedMoveTargetSelectorTypes selector, const uint8 ownPosition, const uint8 opponentPosition, FMCTSRandom& random, FMCTSCellList& newTargets)
 {
-	TArray<FMCTSMoveTargetingData> newTargetingData = {};
-
-	for (int targetingDataIndex = 0; targetingDataIndex < targets.Num(); targetingDataIndex++) {
-		FMCTSMoveTargetingData currentTargetingData = targets[targetingDataIndex];
-		
-		TArray<FVector2D> newTargets = {};
-
-		switch (selectors[currentTargetingData.selectorIndex]) {
-			case EGeneratedMoveTargetSelectorTypes::RandomAny:
-			{
-				TArray<FVector2D> randomTargetOptions = {
-					FVector2D(0,0), FVector2D(0,1), FVector2D(0,2),
-					FVector2D(1,0), FVector2D(1,1), FVector2D(1,2),
-					FVector2D(2,0), FVector2D(2,1), FVector2D(2,2)
-				};
-				int randomChoice = FMath::RandRange(0, randomTargetOptions.Num()-1);
-				newTargets.Add(randomTargetOptions[randomChoice]);
-			}
-				
-			case EGeneratedMoveTargetSelectorTypes::RandomOccupied:
-			{
-				TArray<FVector2D> randomTargetOptions = {
-					ownPosition, opponentPosition
-				};
-				int randomChoice = FMath::RandRange(0, randomTargetOptions.Num() - 1);
-				newTargets.Add(randomTargetOptions[randomChoice]);
-			}
-
-			case EGeneratedMoveTargetSelectorTypes::RandomAdjacent:
-			{
-				TArray<FVector2D> randomTargetOptions = {
-					FVector2D(1,0), FVector2D(0,1),
-					FVector2D(-1,0), FVector2D(0,-1)
-				};
-				int randomChoice = FMath::RandRange(0, randomTargetOptions.Num() - 1);
-				FVector2D adjacentPosition = (ownPosition + randomTargetOptions[randomChoice]).ClampAxes(0,2);
-				if (adjacentPosition != ownPosition)
-					newTargets.AddUnique(adjacentPosition);
-			}
-
-			case EGeneratedMoveTargetSelectorTypes::Opponent:
-				newTargets.Add(opponentPosition);
-
-			case EGeneratedMoveTargetSelectorTypes::Own:
-				newTargets.Add(ownPosition);
+	if (!move.HasTarget())
+		return;
 
-			case EGeneratedMoveTargetSelectorTypes::Line2:
-			{
-				//if (ownPosition == FVector2D(2.0f, 2.0f)) {
-				//	UE_LOG(LogTemp, Error, TEXT("\nFilling a line targeter at (%f, %f) using initial target (%f, %f)"), ownPosition.X, ownPosition.Y, targets[targetingDataIndex].target.X, targets[targetingDataIndex].target.Y);
-				//}
+	const uint8 target = static_cast<uint8>(move.GetTargetCell());
+	const FMCTSBoardTables& board = FMCTSBoardTables::Get();
 
-				FVector2D direction = targets[targetingDataIndex].target - ownPosition;
-				FVector2D newPoint = (targets[targetingDataIndex].target + direction).ClampAxes(0, 2);
+	switch (selector) {
+		case EGeneratedMoveTargetSelectorTypes::RandomAny:
+		{
+			int randomChoice = random.RandRange(0, FMCTSSearchState::NumPlatforms - 1);
+			newTargets.Add(static_cast<uint8>(randomChoice));
+		}
 
-				newTargets.Add(targets[targetingDataIndex].target);
-				newTargets.AddUnique(newPoint);
-			}
+		case EGeneratedMoveTargetSelectorTypes::RandomOccupied:
+		{
+			int randomChoice = random.RandRange(0, 1);
+			newTargets.Add(randomChoice == 0 ? ownPosition : opponentPosition);
+		}
 
-			case EGeneratedMoveTargetSelectorTypes::Line3:
-			{
-				//if (ownPosition == FVector2D(2.0f, 2.0f)) {
-				//	UE_LOG(LogTemp, Error, TEXT("\nFilling a line targeter at (%f, %f) using initial target (%f, %f)"), ownPosition.X, ownPosition.Y, targets[targetingDataIndex].target.X, targets[targetingDataIndex].target.Y);
-				//}
+		case EGeneratedMoveTargetSelectorTypes::RandomAdjacent:
+		{
+			int randomChoice = random.RandRange(0, 3);
+			uint8 adjacentPosition = board.step[ownPosition][randomChoice];
+			if (adjacentPosition != ownPosition)
+				newTargets.AddUnique(adjacentPosition);
+		}
 
-				FVector2D direction = targets[targetingDataIndex].target - ownPosition;
-				FVector2D newPoint = (targets[targetingDataIndex].target + direction).ClampAxes(0, 2);
+		case EGeneratedMoveTargetSelectorTypes::Opponent:
+			newTargets.Add(opponentPosition);
 
-				newTargets.Add(targets[targetingDataIndex].target);
-				newTargets.AddUnique(newPoint);
+		case EGeneratedMoveTargetSelectorTypes::Own:
+			newTargets.Add(ownPosition);
 
-				FVector2D newPoint2 = (newPoint + direction).ClampAxes(0, 2);
-				newTargets.AddUnique(newPoint2);
-			}
+		case EGeneratedMoveTargetSelectorTypes::Line2:
+		{
+			newTargets.Add(target);
+			newTargets.AddUnique(board.rayStep[ownPosition][target][0]);
+		}
 
-			case EGeneratedMoveTargetSelectorTypes::AllAdjacent:
-			{
-				TArray<FVector2D> adjacencyOffsets = {
-					FVector2D(1,0), FVector2D(0,1),
-					FVector2D(-1,0), FVector2D(0,-1)
-				};
-				for (FVector2D offset : adjacencyOffsets) {
-					FVector2D adjacentPosition = (ownPosition + offset).ClampAxes(0, 2);
-					if (adjacentPosition != ownPosition)
-						newTargets.AddUnique(adjacentPosition);
-				}
-			}
+		case EGeneratedMoveTargetSelectorTypes::Line3:
+		{
+			newTargets.Add(target);
+			newTargets.AddUnique(board.rayStep[ownPosition][target][0]);
+			newTargets.AddUnique(board.rayStep[ownPosition][target][1]);
+		}
 
-			default:
-			{
-				// Any selectors that don't need to be filled pass through here unchanged.
-				newTargets.Add(targets[targetingDataIndex].target);
+		case EGeneratedMoveTargetSelectorTypes::AllAdjacent:
+		{
+			for (int direction = 0; direction < 4; direction++) {
+				uint8 adjacentPosition = board.step[ownPosition][direction];
+				if (adjacentPosition != ownPosition)
+					newTargets.AddUnique(adjacentPosition);
 			}
 		}
 
-		for (FVector2D t : newTargets) {
-			newTargetingData.Add(FMCTSMoveTargetingData(currentTargetingData.selectorIndex, t));
+		default:
+		{
+			// Any selectors that don't need to be filled pass through here unchanged.
+			newTargets.Add(target);
 		}
 	}
-
-	
-
-	
-
-	return newTargetingData;
 }
 
-FMCTSPlatformState GetChangedPlatformState(const FMCTSPlatformState inputState, EGeneratedMoveEffectTypes currentEffectType, float modulatedCurrentEffectPower)
+FMCTSSearchPlatform GetChangedPlatformState(const FMCTSSearchPlatform inputState, EGeneratedMoveEffectTypes currentEffectType, float modulatedCurrentEffectPower)
 {
-	FMCTSPlatformState outputState = inputState;
+	FMCTSSearchPlatform outputState = inputState;
 
 	switch (currentEffectType) {
 		case EGeneratedMoveEffectTypes::ChangeTemp:
 			outputState.temp = FMath::Clamp(outputState.temp + modulatedCurrentEffectPower, 0.0f, 1.0f);
 			if (outputState.temp >= 1.0f) {
-				outputState.statuses.AddUnique(EMCTSPlatformStatusTypes::Ignite);
+				outputState.AddStatus(EMCTSPlatformStatusTypes::Ignite);
 			}
 			else if (modulatedCurrentEffectPower < 0) {
-				outputState.statuses.Remove(EMCTSPlatformStatusTypes::Ignite);
+				outputState.RemoveStatus(EMCTSPlatformStatusTypes::Ignite);
 			}
 
 			if (outputState.temp <= 0.0f) {
-				outputState.statuses.AddUnique(EMCTSPlatformStatusTypes::Freeze);
+				outputState.AddStatus(EMCTSPlatformStatusTypes::Freeze);
 			}
 			else if (modulatedCurrentEffectPower > 0) {
-				outputState.statuses.Remove(EMCTSPlatformStatusTypes::Freeze);
+				outputState.RemoveStatus(EMCTSPlatformStatusTypes::Freeze);
 			}
 			break;
 		case EGeneratedMoveEffectTypes::ChangeHum:
 			outputState.hum = FMath::Clamp(outputState.hum + modulatedCurrentEffectPower, 0.0f, 1.0f);
 			if (outputState.hum >= 1.0f) {
-				outputState.statuses.AddUnique(EMCTSPlatformStatusTypes::Flood);
+				outputState.AddStatus(EMCTSPlatformStatusTypes::Flood);
 			}
 			else if (modulatedCurrentEffectPower < 0) {
-				outputState.statuses.Remove(EMCTSPlatformStatusTypes::Flood);
+				outputState.RemoveStatus(EMCTSPlatformStatusTypes::Flood);
 			}
 
 			if (outputState.hum <= 0.0f) {
-				outputState.statuses.AddUnique(EMCTSPlatformStatusTypes::Sandtrap);
+				outputState.AddStatus(EMCTSPlatformStatusTypes::Sandtrap);
 			}
 			else if (modulatedCurrentEffectPower > 0) {
-				outputState.statuses.Remove(EMCTSPlatformStatusTypes::Sandtrap);
+				outputState.RemoveStatus(EMCTSPlatformStatusTypes::Sandtrap);
 			}
 			break;
 		case EGeneratedMoveEffectTypes::ChangeElev:
@@ -222,30 +320,30 @@ FMCTSPlatformState GetChangedPlatformState(const FMCTSPlatformState inputState,
 			break;
 		case EGeneratedMoveEffectTypes::Lockdown:
 			if (modulatedCurrentEffectPower > 0)
-				outputState.statuses.Add(EMCTSPlatformStatusTypes::Lockdown);
+				outputState.AppendStatus(EMCTSPlatformStatusTypes::Lockdown);
 			else
-				outputState.statuses.Remove(EMCTSPlatformStatusTypes::Lockdown);
+				outputState.RemoveStatus(EMCTSPlatformStatusTypes::Lockdown);
 			break;
 		case EGeneratedMoveEffectTypes::Freeze:
 			if (modulatedCurrentEffectPower > 0)
-				outputState.statuses.Add(EMCTSPlatformStatusTypes::Freeze);
+				outputState.AppendStatus(EMCTSPlatformStatusTypes::Freeze);
 			else
-				outputState.statuses.Remove(EMCTSPlatformStatusTypes::Freeze);
+				outputState.RemoveStatus(EMCTSPlatformStatusTypes::Freeze);
 			break;
 		case EGeneratedMoveEffectTypes::Sandtrap:
 			if (modulatedCurrentEffectPower > 0)
-				outputState.statuses.Add(EMCTSPlatformStatusTypes::Sandtrap);
+				outputState.AppendStatus(EMCTSPlatformStatusTypes::Sandtrap);
 			else
-				outputState.statuses.Remove(EMCTSPlatformStatusTypes::Sandtrap);
+				outputState.RemoveStatus(EMCTSPlatformStatusTypes::Sandtrap);
 			break;
 	}
 
 	return outputState;
 }
 
-FMCTSMonsterState GetChangedMonsterState(const FMCTSMonsterState inputState, FVector2D targetCoords, EGeneratedMoveEffectTypes currentEffectType, float modulatedCurrentEffectPower)
+FMCTSSearchMonster GetChangedMonsterState(const FMCTSSearchMonster inputState, uint8 targetCell, EGeneratedMoveEffectTypes currentEffectType, float modulatedCurrentEffectPower)
 {
-	FMCTSMonsterState outputState = inputState;
+	FMCTSSearchMonster outputState = inputState;
 
 	switch (currentEffectType) {
 		case EGeneratedMoveEffectTypes::ChangeAtk:
@@ -268,27 +366,33 @@ FMCTSMonsterState GetChangedMonsterState(const FMCTSMonsterState inputState, FVe
 			break;
 		case EGeneratedMoveEffectTypes::PullPush:
 		case EGeneratedMoveEffectTypes::MoveTo:
-			outputState.position = targetCoords;
+			outputState.cell = targetCell;
 			break;
 	}
 
 	return outputState;
 }
 
-FMCTSMonsterState ComputeMonsterStateFromPlatformState(const FMCTSMonsterState inputState, const FMCTSPlatformState platformState)
+// What standing on the platform makes the monster's score, from how far its conditions are from the platform's.
+static float PlatformScore(const FMCTSSearchMonster& monster, const FMCTSSearchPlatform& platformState)
 {
-	FMCTSMonsterState outputState = inputState;
-
 	float newScore = (
-		FGenericPlatformMath::Abs(platformState.temp - outputState.temp) +
-		FGenericPlatformMath::Abs(platformState.hum - outputState.hum) +
-		FGenericPlatformMath::Abs(platformState.elev - outputState.elev)
+		FGenericPlatformMath::Abs(platformState.temp - monster.temp) +
+		FGenericPlatformMath::Abs(platformState.hum - monster.hum) +
+		FGenericPlatformMath::Abs(platformState.elev - monster.elev)
 		) / 3.0f;
 
-	newScore /= 0.01f * outputState.def;
+	newScore /= 0.01f * monster.def;
 
 	newScore = FMath::Lerp(0.0f, 1.0f, newScore);
-	newScore = FMath::Clamp(newScore, 0.0f, 1.0f) * 100.0f;
+	return FMath::Clamp(newScore, 0.0f, 1.0f) * 100.0f;
+}
+
+FMCTSSearchMonster ComputeMonsterStateFromPlatformState(const FMCTSSearchMonster inputState, const FMCTSSearchPlatform platformState)
+{
+	FMCTSSearchMonster outputState = inputState;
+
+	float newScore = PlatformScore(outputState, platformState);
 
 	float scoreRatio = (newScore / outputState.score);
 
@@ -299,252 +403,300 @@ FMCTSMonsterState ComputeMonsterStateFromPlatformState(const FMCTSMonsterState i
 	return outputState;
 }
 
-FMCTSGameState FMCTSBattleRuleset::NextState(const FMCTSGameState& state, const FMCTSMove& move)
+static void ApplyPlatformStatesToMonsters(FMCTSSearchState& state)
 {
-	FMCTSGameState resultingState = state;
+	for (int monsterStateIndex = 0; monsterStateIndex < FMCTSSearchState::NumMonsters; monsterStateIndex++) {
+		const int currentPlatformIndex = state.monsters[monsterStateIndex].cell;
+		state.monsters[monsterStateIndex] = ComputeMonsterStateFromPlatformState(state.monsters[monsterStateIndex], state.platforms[currentPlatformIndex]);
+	}
+}
 
-	bool actingPlayerIsFaster = resultingState.monsterStates[state.actingPlayerIndex].spd > resultingState.monsterStates[1-state.actingPlayerIndex].spd;
+void FMCTSBattleRuleset::CompileReactions()
+{
+	reactions.Reset();
+
+	// Slip, stamp and splash are system moves -2, -3 and -4, and only ever use their first selector
+	const int numReactions = FMath::Min(systemMoveList.Num(), 3);
+	for (int reactionIndex = 0; reactionIndex < numReactions; reactionIndex++) {
+		FMCTSCompiledReaction& reaction = reactions.AddDefaulted_GetRef();
+		const FMCTSCompiledMove& compiledMove = systemMoveList[reactionIndex];
+		if (compiledMove.numLists == 0)
+			continue;
 
-	if (move.moveIndex == -1) {
-		if (!actingPlayerIsFaster)
-			resultingState.turnCount++;
-		resultingState.actingPlayerIndex = 1 - resultingState.actingPlayerIndex;
-		resultingState.monsterStates[0].ap = 2;
-		resultingState.monsterStates[1].ap = 2;
-		return resultingState;
-	}
+		reaction.effectList = compiledMove.firstList;
+		const EGeneratedMoveTargetSelectorTypes selector = effectLists[reaction.effectList].selector;
+		reaction.bRandomTargets = IsRandomSelector(selector);
+		if (reaction.bRandomTargets || selector == EGeneratedMoveTargetSelectorTypes::Opponent)
+			continue;
 
-	int castersIndex = state.actingPlayerIndex;
-	int opponentsIndex = 1 - castersIndex; 
-
-	TArray<FVector2D> platformCoordinatesArray = { 
-		FVector2D(0,0), FVector2D(0,1), FVector2D(0,2), 
-		FVector2D(1,0), FVector2D(1,1), FVector2D(1,2), 
-		FVector2D(2,0), FVector2D(2,1), FVector2D(2,2) 
-	};
-
-	TArray<FGeneratedEffectList> effectLists;
-	TArray<EGeneratedMoveTargetSelectorTypes> selectors;
-
-	if (move.moveIndex >= 0) {
-		effectLists =
-			(state.actingPlayerIndex == 0 ?
-				playerMoveList[move.moveIndex].effectLists :
-				opponentMoveList[move.moveIndex].effectLists);
-
-		selectors =
-			(state.actingPlayerIndex == 0 ?
-				playerMoveList[move.moveIndex].selectors :
-				opponentMoveList[move.moveIndex].selectors);
+		// Nothing random gets drawn for these selectors, and the opponent's cell is never read
+		FMCTSRandom unused;
+		reaction.targets.SetNum(FMCTSSearchState::NumPlatforms * FMCTSSearchState::NumPlatforms);
+		for (uint8 casterCell = 0; casterCell < FMCTSSearchState::NumPlatforms; casterCell++) {
+			for (uint8 landingCell = 0; landingCell < FMCTSSearchState::NumPlatforms; landingCell++) {
+				const FMCTSMoveId move = FMCTSMoveId::Make(0, -2 - reactionIndex, 0, landingCell, 0);
+				FillMoveTargets(move, selector, casterCell, 0, unused, reaction.targets[casterCell * FMCTSSearchState::NumPlatforms + landingCell]);
+			}
+		}
 	}
-	else {
-		int systemMoveListIndex =  (0 - move.moveIndex) - 2;
-		effectLists = systemMoveList[systemMoveListIndex].effectLists;
-		selectors = systemMoveList[systemMoveListIndex].selectors;
+}
+
+// Same as ApplyMoveInPlace on the reaction's system move, minus everything a zero-cost, never-jumping move skips anyway.
+void FMCTSBattleRuleset::ApplyReaction(const FMCTSCompiledReaction& reaction, const int castersIndex, const uint8 landingCell, FMCTSSearchState& state, FMCTSRandom& random, FMCTSStateJournal* journal) const
+{
+	if (reaction.effectList != INDEX_NONE) {
+		const FMCTSCompiledEffectList& effectList = effectLists[reaction.effectList];
+		const uint8 casterCell = state.monsters[castersIndex].cell;
+
+		FMCTSCellList filledTargets;
+		const FMCTSCellList* targets = &filledTargets;
+		if (reaction.targets.IsEmpty())
+			FillMoveTargets(FMCTSMoveId::Make(castersIndex, -2, 0, landingCell, 0), effectList.selector, casterCell, state.monsters[1 - castersIndex].cell, random, filledTargets);
+		else
+			targets = &reaction.targets[casterCell * FMCTSSearchState::NumPlatforms + landingCell];
+
+		if (journal)
+			journal->SavePlatforms(state, targets->mask);
+
+		for (int targetIndex = 0; targetIndex < targets->num; targetIndex++)
+			RunEffectList(effectList, castersIndex, targets->cells[targetIndex], state);
 	}
 
-	// Take the move targeting data and fill in any additional targets based on the selector
-	// TODO: if positions are changing throughout the below effects list, this should be updated. 
-	TArray<FMCTSMoveTargetingData> filledMoveTargets = FillMoveTargets(move.targets, selectors, resultingState.monsterStates[castersIndex].position, resultingState.monsterStates[opponentsIndex].position);
+	ApplyPlatformStatesToMonsters(state);
+}
 
-	for (FMCTSMoveTargetingData moveTargetingData : filledMoveTargets) {
-		FVector2D currentTargetCoords = moveTargetingData.target;
-		int currentTargetPlatformIndex = platformCoordinatesArray.Find(currentTargetCoords);
+void FMCTSBattleRuleset::RunEffectList(const FMCTSCompiledEffectList& effectList, const int castersIndex, const uint8 currentTargetCell, FMCTSSearchState& resultingState) const
+{
+	const int opponentsIndex = 1 - castersIndex;
+	const int currentTargetPlatformIndex = currentTargetCell;
+	const FMCTSEffectInstruction* instructions = program.GetData() + effectList.firstInstruction;
+
+	bool gateNextEffect = false;
+	bool overwriteNextEffectPower = false;
+	float storedEffectPower = 0;
+	for (int instructionIndex = 0; instructionIndex < effectList.numInstructions; instructionIndex++) {
+		const FMCTSEffectInstruction& instruction = instructions[instructionIndex];
+
+		// Get the current effect's info (power is already in the 0.0f - 1.0f range)
+		float currentEffectPower = instruction.power;
+		EGeneratedMoveEffectTypes currentEffectType = instruction.type;
+
+		// Skip this effect if there's a pending gate
+		if (gateNextEffect) {
+			gateNextEffect = false;
+			continue;
+		}
 
-		if (currentTargetPlatformIndex < 0) {
-			UE_LOG(LogTemp, Error, TEXT("Couldn't find platform index for coordinates: (%d, %d)"), 
-				static_cast<int>(currentTargetCoords.X), static_cast<int>(currentTargetCoords.Y));
+		// Overwrite this effect's power if there's a pending stored power
+		if (overwriteNextEffectPower) {
+			overwriteNextEffectPower = false;
+			currentEffectPower = storedEffectPower / 100.0f;
 		}
 
+		// Modulate current effect power based on stats (the caster may have been changed by prior effects in this loop)
+		const float casterModulation = (resultingState.monsters[castersIndex].atk * 0.01f) + 0.5f;
 
-		bool gateNextEffect = false;
-		bool overwriteNextEffectPower = false;
-		float storedEffectPower = 0;
-		for (FGeneratedEffect currentEffect : effectLists[moveTargetingData.selectorIndex].effects) {
+		// Fused gate/store, see CompileEffectList. Nothing can be pending here.
+		if (instruction.prefix == EMCTSEffectPrefix::Gate) {
+			if (GateHolds(resultingState.platforms[currentTargetPlatformIndex], instruction.prefixCondition, instruction.prefixPower))
+				continue;
+		}
+		else if (instruction.prefix == EMCTSEffectPrefix::Store) {
+			const float stored = GetPlatformCondition(resultingState.platforms[currentTargetPlatformIndex], instruction.prefixCondition) * (instruction.prefixPower * casterModulation);
+			currentEffectPower = stored / 100.0f;
+		}
 
-			// Get the current effect's info
-			float currentEffectPower = currentEffect.power;
-			EGeneratedMoveEffectTypes currentEffectType = currentEffect.type;
+		float modulatedCurrentEffectPower = currentEffectPower * casterModulation;
 
-			// Skip this effect if there's a pending gate
-			if (gateNextEffect) {
-				gateNextEffect = false;
-				continue;
-			}
+		switch (currentEffectType) {
 
-			// Overwrite this effect's power if there's a pending stored power
-			if (overwriteNextEffectPower) {
-				overwriteNextEffectPower = false;
-				currentEffectPower = storedEffectPower;
-			}
+		// Affect platform state
+		case EGeneratedMoveEffectTypes::ChangeTemp:
+		case EGeneratedMoveEffectTypes::ChangeHum:
+		case EGeneratedMoveEffectTypes::ChangeElev:
+		case EGeneratedMoveEffectTypes::Lockdown:
+		case EGeneratedMoveEffectTypes::Freeze:
+		case EGeneratedMoveEffectTypes::Sandtrap:
+			resultingState.platforms[currentTargetPlatformIndex] = GetChangedPlatformState(resultingState.platforms[currentTargetPlatformIndex], currentEffectType, modulatedCurrentEffectPower);
+			break;
 
-			// Snapshot the current state of monsters (may have been changed by prior effects in this loop)
-			FMCTSMonsterState casterMonsterState = resultingState.monsterStates[castersIndex];
-			FMCTSMonsterState opponentMonsterState = resultingState.monsterStates[opponentsIndex];
 
-			// Modulate current effect power based on stats, and move from 0-100 range to 0.0f - 1.0f range.
-			currentEffectPower = currentEffectPower / 100.0f;
-			float modulatedCurrentEffectPower = currentEffectPower * ((casterMonsterState.atk * 0.01f) + 0.5f);
+		// Change power of next effect
+		case EGeneratedMoveEffectTypes::StoreTemp:
+			storedEffectPower = resultingState.platforms[currentTargetPlatformIndex].temp * modulatedCurrentEffectPower;
+			overwriteNextEffectPower = true;
+			break;
+		case EGeneratedMoveEffectTypes::StoreHum:
+			storedEffectPower = resultingState.platforms[currentTargetPlatformIndex].hum * modulatedCurrentEffectPower;
+			overwriteNextEffectPower = true;
+			break;
+		case EGeneratedMoveEffectTypes::StoreElev:
+			storedEffectPower = resultingState.platforms[currentTargetPlatformIndex].elev * modulatedCurrentEffectPower;
+			overwriteNextEffectPower = true;
+			break;
 
-			switch (currentEffectType) {
+		// Gate based on thresholds
+		case EGeneratedMoveEffectTypes::GateTemp:
+			gateNextEffect = currentEffectPower < 0 ?
+				resultingState.platforms[currentTargetPlatformIndex].temp >= -currentEffectPower :
+				resultingState.platforms[currentTargetPlatformIndex].temp <= currentEffectPower;
+			break;
+		case EGeneratedMoveEffectTypes::GateHum:
+			gateNextEffect = currentEffectPower < 0 ?
+				resultingState.platforms[currentTargetPlatformIndex].hum >= -currentEffectPower :
+				resultingState.platforms[currentTargetPlatformIndex].hum <= currentEffectPower;
+			break;
+		case EGeneratedMoveEffectTypes::GateElev:
+			gateNextEffect = currentEffectPower < 0 ?
+				resultingState.platforms[currentTargetPlatformIndex].elev >= -currentEffectPower :
+				resultingState.platforms[currentTargetPlatformIndex].elev <= currentEffectPower;
+			break;
 
-			// Affect platform state
-			case EGeneratedMoveEffectTypes::ChangeTemp:
-			case EGeneratedMoveEffectTypes::ChangeHum:
-			case EGeneratedMoveEffectTypes::ChangeElev:
-			case EGeneratedMoveEffectTypes::Lockdown:
-			case EGeneratedMoveEffectTypes::Freeze:
-			case EGeneratedMoveEffectTypes::Sandtrap:
-				resultingState.platformStates[currentTargetPlatformIndex] = GetChangedPlatformState(resultingState.platformStates[currentTargetPlatformIndex], currentEffectType, modulatedCurrentEffectPower);
-				break;
+		// Affect monster at targeted platform
+		case EGeneratedMoveEffectTypes::ChangeAtk:
+		case EGeneratedMoveEffectTypes::ChangeDef:
+		case EGeneratedMoveEffectTypes::ChangeSpd:
+			for (int monsterStateIndex = 0; monsterStateIndex < FMCTSSearchState::NumMonsters; monsterStateIndex++) {
+				if (resultingState.monsters[monsterStateIndex].cell == currentTargetCell)
+					resultingState.monsters[monsterStateIndex] = GetChangedMonsterState(resultingState.monsters[monsterStateIndex], currentTargetCell, currentEffectType, modulatedCurrentEffectPower);
+			}
+			break;
 
+		// Affect opponent monster
+		case EGeneratedMoveEffectTypes::PullPush:
+			{// Can land off the board or between cells, see CellOf.
+			const FVector2D opponentPosition = FMCTSSearchState::PositionOf(resultingState.monsters[opponentsIndex].cell);
+			uint8 resultingLocation = FMCTSSearchState::CellOf(opponentPosition - opponentPosition * modulatedCurrentEffectPower);
+			resultingState.monsters[opponentsIndex] = GetChangedMonsterState(resultingState.monsters[opponentsIndex], resultingLocation, currentEffectType, modulatedCurrentEffectPower);}
+			break;
 
-			// Change power of next effect
-			case EGeneratedMoveEffectTypes::StoreTemp:
-				storedEffectPower = resultingState.platformStates[currentTargetPlatformIndex].temp * modulatedCurrentEffectPower;
-				overwriteNextEffectPower = true;
-				break;
-			case EGeneratedMoveEffectTypes::StoreHum:
-				storedEffectPower = resultingState.platformStates[currentTargetPlatformIndex].hum * modulatedCurrentEffectPower;
-				overwriteNextEffectPower = true;
-				break;
-			case EGeneratedMoveEffectTypes::StoreElev:
-				storedEffectPower = resultingState.platformStates[currentTargetPlatformIndex].elev * modulatedCurrentEffectPower;
-				overwriteNextEffectPower = true;
-				break;
+		// Affect caster monster
+		case EGeneratedMoveEffectTypes::MoveTo: {
+				resultingState.monsters[castersIndex] = GetChangedMonsterState(resultingState.monsters[castersIndex], currentTargetCell, currentEffectType, modulatedCurrentEffectPower);
+			}
+			break;
 
-			// Gate based on thresholds
-			case EGeneratedMoveEffectTypes::GateTemp:
-				gateNextEffect = currentEffectPower < 0 ?
-					resultingState.platformStates[currentTargetPlatformIndex].temp >= -currentEffectPower :
-					resultingState.platformStates[currentTargetPlatformIndex].temp <= currentEffectPower;
-				break;
-			case EGeneratedMoveEffectTypes::GateHum:
-				gateNextEffect = currentEffectPower < 0 ?
-					resultingState.platformStates[currentTargetPlatformIndex].hum >= -currentEffectPower :
-					resultingState.platformStates[currentTargetPlatformIndex].hum <= currentEffectPower;
-				break;
-			case EGeneratedMoveEffectTypes::GateElev:
-				gateNextEffect = currentEffectPower < 0 ?
-					resultingState.platformStates[currentTargetPlatformIndex].elev >= -currentEffectPower :
-					resultingState.platformStates[currentTargetPlatformIndex].elev <= currentEffectPower;
-				break;
+		}
+	}
+}
 
-			// Affect monster at targeted platform
-			case EGeneratedMoveEffectTypes::ChangeAtk:
-			case EGeneratedMoveEffectTypes::ChangeDef:
-			case EGeneratedMoveEffectTypes::ChangeSpd:
-				for (int monsterStateIndex = 0; monsterStateIndex < resultingState.monsterStates.Num(); monsterStateIndex++) {
-					if (resultingState.monsterStates[monsterStateIndex].position == currentTargetCoords)
-						resultingState.monsterStates[monsterStateIndex] = GetChangedMonsterState(resultingState.monsterStates[monsterStateIndex], currentTargetCoords, currentEffectType, modulatedCurrentEffectPower);
-				}
-				break;
+FMCTSSearchState FMCTSBattleRuleset::NextState(const FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random)
+{
+	FMCTSSearchState resultingState = state;
+	ApplyMoveInPlace(resultingState, move, random, nullptr);
+	return resultingState;
+}
 
-			// Affect opponent monster
-			case EGeneratedMoveEffectTypes::PullPush: 
-				{FVector2D resultingLocation = (resultingState.monsterStates[opponentsIndex].position - resultingState.monsterStates[opponentsIndex].position * modulatedCurrentEffectPower).ClampAxes(0, 2);
-				resultingState.monsterStates[opponentsIndex] = GetChangedMonsterState(resultingState.monsterStates[opponentsIndex], resultingLocation, currentEffectType, modulatedCurrentEffectPower);}
-				break;
+void FMCTSBattleRuleset::ApplyMove(FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random, FMCTSStateJournal* journal)
+{
+	if (journal)
+		journal->BeginMove(state);
+	ApplyMoveInPlace(state, move, random, journal);
+}
 
-			// Affect caster monster
-			case EGeneratedMoveEffectTypes::MoveTo: {
-					resultingState.monsterStates[castersIndex] = GetChangedMonsterState(resultingState.monsterStates[castersIndex], currentTargetCoords, currentEffectType, modulatedCurrentEffectPower);
-				}
-				break;
+void FMCTSBattleRuleset::ApplyMoveInPlace(FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random, FMCTSStateJournal* journal)
+{
+	bool actingPlayerIsFaster = state.monsters[state.actingPlayerIndex].spd > state.monsters[1-state.actingPlayerIndex].spd;
 
-			}
-			
-		}
+	if (move.IsEndTurn()) {
+		if (!actingPlayerIsFaster)
+			state.turnCount++;
+		state.actingPlayerIndex = 1 - state.actingPlayerIndex;
+		state.monsters[0].ap = 2;
+		state.monsters[1].ap = 2;
+		return;
+	}
+
+	int castersIndex = state.actingPlayerIndex;
+	int opponentsIndex = 1 - castersIndex;
+
+	const int moveIndex = move.GetMoveIndex();
+	const FMCTSCompiledMove& compiledMove =
+		moveIndex >= 0 ?
+			(state.actingPlayerIndex == 0 ? playerMoveList[moveIndex] : opponentMoveList[moveIndex]) :
+			systemMoveList[(0 - moveIndex) - 2];
+
+	// Only a jump can be blocked by a sandtrap, and then the whole move gets taken back
+	const bool isJump = moveIndex == 0;
+	FMCTSSearchState stateBeforeJump;
+	if (isJump)
+		stateBeforeJump = state;
+
+	if (move.GetSelectorIndex() < compiledMove.numLists) {
+		const FMCTSCompiledEffectList& effectList = effectLists[compiledMove.firstList + move.GetSelectorIndex()];
+
+		// Take the move targeting data and fill in any additional targets based on the selector
+		// TODO: if positions are changing throughout the below effects list, this should be updated.
+		FMCTSCellList filledMoveTargets;
+		FillMoveTargets(move, effectList.selector, state.monsters[castersIndex].cell, state.monsters[opponentsIndex].cell, random, filledMoveTargets);
+
+		// Effects only ever write to the platform they target
+		if (journal)
+			journal->SavePlatforms(state, filledMoveTargets.mask);
+
+		for (int filledTargetIndex = 0; filledTargetIndex < filledMoveTargets.num; filledTargetIndex++)
+			RunEffectList(effectList, castersIndex, filledMoveTargets.cells[filledTargetIndex], state);
 	}
 
 	// Subtract the cost of the move from their AP
-	resultingState.monsterStates[castersIndex].ap -= move.cost;
+	state.monsters[castersIndex].ap -= move.GetCost();
 
 	// Apply platform states to monster states
-	for (int monsterStateIndex = 0; monsterStateIndex < resultingState.monsterStates.Num(); monsterStateIndex++) {
-		const FVector2D currentMonsterPosition = resultingState.monsterStates[monsterStateIndex].position;
-		int currentPlatformIndex = platformCoordinatesArray.Find(currentMonsterPosition);
-
-		if (currentPlatformIndex < 0) {
-			UE_LOG(LogTemp, Error, TEXT("Couldn't find platform index for coordinates: (%d, %d)"),
-				static_cast<int>(currentMonsterPosition.X), static_cast<int>(currentMonsterPosition.Y));
-		}
-
-		resultingState.monsterStates[monsterStateIndex] = ComputeMonsterStateFromPlatformState(resultingState.monsterStates[monsterStateIndex], resultingState.platformStates[currentPlatformIndex]);
-	}
+	ApplyPlatformStatesToMonsters(state);
 
 	bool undoMove = false;
-	ApplyPlatformStatusTriggersToState(castersIndex, move, resultingState, undoMove);
+	ApplyPlatformStatusTriggersToState(castersIndex, move, state, random, journal, undoMove);
 
 	if (undoMove) {
-		resultingState = state;
-		resultingState.monsterStates[castersIndex].ap -= 1;
-		return resultingState;
+		// Nothing has run on a blocked jump but its own effects, so the journal already holds every platform this restores
+		state = stateBeforeJump;
+		state.monsters[castersIndex].ap -= 1;
 	}
-
-	return resultingState;
 }
 
-TArray<FMCTSMove> FMCTSBattleRuleset::EnumerateMoves(const FMCTSGameState& state) 
+void FMCTSBattleRuleset::EnumerateMoves(const FMCTSSearchState& state, FMCTSMoveList& outMoves)
 {
 	int actingPlayerIndex = state.actingPlayerIndex;
-	FVector2D playerPosition = state.monsterStates[actingPlayerIndex].position;
-	FVector2D opponentPosition = state.monsterStates[1 - actingPlayerIndex].position;
+	uint8 playerPosition = state.monsters[actingPlayerIndex].cell;
+	const FMCTSBoardTables& board = FMCTSBoardTables::Get();
 
-	TArray<FMCTSMove> possibleMoves = {};
+	outMoves.Reset();
 
-	auto moveList = state.actingPlayerIndex == 0 ? playerMoveList : opponentMoveList;
+	const TArray<FMCTSCompiledMove>& moveList = state.actingPlayerIndex == 0 ? playerMoveList : opponentMoveList;
 
 	for (int currentMoveIndex = 0; currentMoveIndex < moveList.Num(); currentMoveIndex++) {
-		FGeneratedMove currentMove = moveList[currentMoveIndex];
+		const FMCTSCompiledMove& currentMove = moveList[currentMoveIndex];
 
-		if (currentMove.cost > state.monsterStates[actingPlayerIndex].ap) 
+		if (currentMove.cost > state.monsters[actingPlayerIndex].ap)
 			continue;
 
-		for (int currentSelectorIndex = 0; currentSelectorIndex < currentMove.selectors.Num(); currentSelectorIndex++) {
+		// Every selector's targets go into one list, since they all make the same move id (selector 0, see below).
+		// Multi-selector moves and the shared dummy (0,0) target then only come out once, at their first position.
+		// Otherwise the order is the old one: selector by selector, cells ascending, and Occupied player first.
+		FMCTSCellList targetsToTry;
+		const auto addBoard = [&targetsToTry](uint16 cells) {
+			ForEachCell(cells, [&targetsToTry](uint8 cell) { targetsToTry.AddUnique(cell); });
+		};
 
-			EGeneratedMoveTargetSelectorTypes currentMoveTargetSelector = currentMove.selectors[currentSelectorIndex];
+		for (int currentSelectorIndex = 0; currentSelectorIndex < currentMove.numLists; currentSelectorIndex++) {
 
-			// TODO: Move this outside of the selectors list
-			TArray<FVector2D> targetsToTry = {};
+			EGeneratedMoveTargetSelectorTypes currentMoveTargetSelector = effectLists[currentMove.firstList + currentSelectorIndex].selector;
 
 			switch (currentMoveTargetSelector) {
-			case EGeneratedMoveTargetSelectorTypes::Any: 
-				{
-					for (int x = 0; x <= 2; x++) {
-						for (int y = 0; y <= 2; y++) {
-							targetsToTry.Add(FVector2D(x, y));
-						}
-					}
-				}
+			case EGeneratedMoveTargetSelectorTypes::Any:
+				addBoard(FMCTSSearchState::AllCellsMask);
 				break;
 
 			case EGeneratedMoveTargetSelectorTypes::Adjacent:
 			case EGeneratedMoveTargetSelectorTypes::Line2:
 			case EGeneratedMoveTargetSelectorTypes::Line3:
-				{
-					for (int x = -1; x <= 1; x++) {
-						for (int y = -1; y <= 1; y++) {
-							if (x == y || !(x == 0 || y == 0)) continue;
-							FVector2D targetedPosition = FVector2D(x, y) + playerPosition;
-							targetedPosition = targetedPosition.ClampAxes(0, 2);
-							if (targetedPosition.X != playerPosition.X || targetedPosition.Y != playerPosition.Y) {
-								targetsToTry.AddUnique(targetedPosition);
-								if (playerPosition == FVector2D(2.0f, 2.0f) && targetedPosition == FVector2D(0, 0) && (currentMoveTargetSelector == EGeneratedMoveTargetSelectorTypes::Line2 || currentMoveTargetSelector == EGeneratedMoveTargetSelectorTypes::Line3)) {
-									UE_LOG(LogTemp, Error, TEXT("\nEnumerating options for a line targeter at (%f, %f): adding initial target (%f, %f)"), playerPosition.X, playerPosition.Y, targetedPosition.X, targetedPosition.Y);
-								}
-							}
-
-						}
-					}
-				}
+				addBoard(board.adjacentMask[playerPosition]);
 				break;
 
+			// Both monsters on one cell is a single target.
 			case EGeneratedMoveTargetSelectorTypes::Occupied:
-				{
-					targetsToTry.Add(playerPosition);
-					targetsToTry.Add(opponentPosition);
-				}
+				targetsToTry.AddUnique(playerPosition);
+				addBoard(state.OccupancyMask());
 				break;
 
 			case EGeneratedMoveTargetSelectorTypes::RandomAny:
@@ -553,37 +705,134 @@ TArray<FMCTSMove> FMCTSBattleRuleset::EnumerateMoves(const FMCTSGameState& state
 			case EGeneratedMoveTargetSelectorTypes::Opponent:
 			case EGeneratedMoveTargetSelectorTypes::Own:
 			case EGeneratedMoveTargetSelectorTypes::AllAdjacent:
-				{
-					targetsToTry.Add(FVector2D(0, 0));
-				}
+				targetsToTry.AddUnique(FMCTSSearchState::MakeCell(0, 0));
 				break;
 			}
+		}
 
-			// TODO: Move this outside of the selectors list.
-			for (FVector2D target : targetsToTry) {
-				FMCTSMove newMove = FMCTSMove(actingPlayerIndex);
-				newMove.moveIndex = currentMoveIndex;
-				newMove.targets = {FMCTSMoveTargetingData(currentSelectorIndex, target)};
-				newMove.playerIndex = actingPlayerIndex;
-				newMove.cost = currentMove.cost;
-				possibleMoves.Add(newMove);
-			}
+		for (int targetIndex = 0; targetIndex < targetsToTry.num; targetIndex++) {
+			// Selector 0, same as FMCTSMoveTargetingData(currentSelectorIndex, target) has always stored.
+			outMoves.Add(FMCTSMoveId::Make(actingPlayerIndex, currentMoveIndex, 0, targetsToTry.cells[targetIndex], currentMove.cost));
 		}
 	}
 
 	// Add the 0-cost "End Turn" move to the possible moves list as well.
-	possibleMoves.Add(FMCTSMove(actingPlayerIndex));
+	outMoves.Add(FMCTSMoveId::EndTurn(actingPlayerIndex));
+}
+
+static constexpr int LastTurn = 10;
 
-	return possibleMoves;
+static bool IsTerminalTurn(int turnCount)
+{
+	return turnCount > LastTurn;
+}
+
+bool FMCTSBattleRuleset::IsTerminalState(const FMCTSSearchState& state)
+{
+	return IsTerminalTurn(state.turnCount);
 }
 
-bool FMCTSBattleRuleset::IsTerminalState(const FMCTSGameState& state)
+// A turn is one go each: turnCount goes up when the slower monster ends its turn.
+int32 FMCTSBattleRuleset::TurnsRemaining(const FMCTSSearchState& state)
 {
-	return state.turnCount > 10;
+	return FMath::Max(LastTurn + 1 - state.turnCount, 0);
 }
 
-bool FMCTSBattleRuleset::EvaluateTerminalState(const FMCTSGameState& state, int _playerIndex)
+bool FMCTSBattleRuleset::EvaluateTerminalState(const FMCTSSearchState& state, int _playerIndex)
 {
-	return state.monsterStates[_playerIndex].score > state.monsterStates[1 - _playerIndex].score;
+	return state.monsters[_playerIndex].score > state.monsters[1 - _playerIndex].score;
 }
 
+// Score points for a 73% chance, and how much a point of PlatformScore lead counts next to a point of actual score.
+static constexpr float EvaluationScale = 10.0f;
+static constexpr float PlatformLeadWeight = 0.25f;
+
+// Static guess for cut-off playouts: the score lead, which decides the game at the end, nudged by whose platform
+// suits them better, squashed into [0, 1]. Two PlatformScores and an exp, so far cheaper than the moves it replaces.
+// No move changes a monster's score, so within one search the score lead is the same for every state: it only sets
+// where the guesses sit between 0 and 1, and the platform lead is what tells states apart.
+float FMCTSBattleRuleset::EvaluateState(const FMCTSSearchState& state, int _playerIndex)
+{
+	if (IsTerminalTurn(state.turnCount))
+		return EvaluateTerminalState(state, _playerIndex) ? 1.0f : 0.0f;
+
+	const float scoreLead = state.monsters[_playerIndex].score - state.monsters[1 - _playerIndex].score;
+	return 1.0f / (1.0f + FMath::Exp(-(scoreLead + PlatformLeadWeight * PlatformLead(state, _playerIndex)) / EvaluationScale));
+}
+
+float FMCTSBattleRuleset::PlatformLead(const FMCTSSearchState& state, int _playerIndex) const
+{
+	const FMCTSSearchMonster& player = state.monsters[_playerIndex];
+	const FMCTSSearchMonster& opponent = state.monsters[1 - _playerIndex];
+	return PlatformScore(player, state.platforms[player.cell]) - PlatformScore(opponent, state.platforms[opponent.cell]);
+}
+
+// Runs each move's effects on copies of the two monsters and only the platforms it targets (all RunEffectList reads or
+// writes), then sees how each monster's PlatformScore moved: up for the caster and down for the opponent is good.
+// Jump reactions, settling and AP are left out, which is what makes it cheap.
+void FMCTSBattleRuleset::EstimateMoveGains(const FMCTSSearchState& state, const FMCTSMoveList& moves, FMCTSRandom& random, float* outGains) const
+{
+	const int castersIndex = state.actingPlayerIndex;
+	const TArray<FMCTSCompiledMove>& moveList = castersIndex == 0 ? playerMoveList : opponentMoveList;
+	const uint16 occupancy = state.OccupancyMask();
+
+	float scoresBefore[FMCTSSearchState::NumMonsters];
+	for (int m = 0; m < FMCTSSearchState::NumMonsters; m++)
+		scoresBefore[m] = PlatformScore(state.monsters[m], state.platforms[state.monsters[m].cell]);
+
+	FMCTSSearchState scratch;
+	for (int moveIndex = 0; moveIndex < moves.Num(); moveIndex++) {
+		const FMCTSMoveId move = moves[moveIndex];
+		outGains[moveIndex] = 0.0f;
+		if (move.IsEndTurn())
+			continue;
+
+		const FMCTSCompiledMove& compiledMove = moveList[move.GetMoveIndex()];
+		if (move.GetSelectorIndex() >= compiledMove.numLists)
+			continue;
+
+		const FMCTSCompiledEffectList& effectList = effectLists[compiledMove.firstList + move.GetSelectorIndex()];
+		FMCTSCellList targets;
+		FillMoveTargets(move, effectList.selector, state.monsters[castersIndex].cell, state.monsters[1 - castersIndex].cell, random, targets);
+
+		// Effects on platforms nobody stands on, or ends up on, don't move anyone's PlatformScore
+		if (!(targets.mask & occupancy) && !effectList.bMovesMonsters)
+			continue;
+
+		for (int m = 0; m < FMCTSSearchState::NumMonsters; m++)
+			scratch.monsters[m] = state.monsters[m];
+		ForEachCell(targets.mask, [&](uint8 target) { scratch.platforms[target] = state.platforms[target]; });
+
+		for (int targetIndex = 0; targetIndex < targets.num; targetIndex++)
+			RunEffectList(effectList, castersIndex, targets.cells[targetIndex], scratch);
+
+		float gain = 0.0f;
+		for (int m = 0; m < FMCTSSearchState::NumMonsters; m++) {
+			const FMCTSSearchMonster& after = scratch.monsters[m];
+			// A monster can be moved off the targets, onto a platform nothing touched
+			const FMCTSSearchPlatform& platformAfter = (targets.mask & FMCTSSearchState::CellBit(after.cell)) ? scratch.platforms[after.cell] : state.platforms[after.cell];
+			const float delta = PlatformScore(after, platformAfter) - scoresBefore[m];
+			gain += m == castersIndex ? delta : -delta;
+		}
+		outGains[moveIndex] = gain;
+	}
+}
+
+bool FMCTSBattleRuleset::HasRandomOutcome(const FMCTSSearchState& state, FMCTSMoveId move)
+{
+	if (move.IsEndTurn())
+		return false;
+
+	const FMCTSCompiledMove& compiledMove = (state.actingPlayerIndex == 0 ? playerMoveList : opponentMoveList)[move.GetMoveIndex()];
+	if (move.GetSelectorIndex() < compiledMove.numLists && IsRandomSelector(effectLists[compiledMove.firstList + move.GetSelectorIndex()].selector))
+		return true;
+
+	// A jump can set off a reaction with random targets
+	if (move.GetMoveIndex() == 0) {
+		for (const FMCTSCompiledReaction& reaction : reactions) {
+			if (reaction.bRandomTargets)
+				return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,302 @@
+#include "MCTSBenchmark.h"
+#include "HAL/PlatformTime.h"
+
+void FMCTSBenchmark::ThreadScaling(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int iterationBudget)
+{
+	const int threadCounts[] = { 1, 2, 4, 8, 16 };
+	const EMCTSParallelMode modes[] = { EMCTSParallelMode::Root, EMCTSParallelMode::Tree };
+
+	for (EMCTSParallelMode mode : modes) {
+		double singleThreadRate = 0.0;
+
+		UE_LOG(LogTemp, Display, TEXT("******MCTS Thread Scaling, %s parallel (%d iterations per thread)***********"),
+			mode == EMCTSParallelMode::Root ? TEXT("root") : TEXT("tree"), iterationBudget);
+
+		for (int threads : threadCounts) {
+			FMCTSBattleAgent agent = FMCTSBattleAgent(iterationBudget);
+			agent.ruleSet = &ruleSet;
+			agent.SetParallelism(mode, threads);
+
+			const double startTime = FPlatformTime::Seconds();
+			const int64 iterations = agent.RunSearch(startingState);
+			const double elapsed = FMath::Max(FPlatformTime::Seconds() - startTime, 1e-6);
+
+			const double rate = iterations / elapsed;
+			if (threads == 1)
+				singleThreadRate = rate;
+
+			UE_LOG(LogTemp, Display, TEXT("%2d threads: %lld iterations in %.3fs = %.1f it/s (x%.2f)"),
+				threads, iterations, elapsed, rate, singleThreadRate > 0.0 ? rate / singleThreadRate : 0.0);
+		}
+	}
+}
+
+// Times one RunSearch from the starting state on a fresh agent, returning iterations/sec.
+template<typename TAgent, typename TRuleSet>
+static double TimeSearch(TRuleSet& ruleSet, const FMCTSGameState& startingState, int iterationBudget)
+{
+	TAgent agent = TAgent(iterationBudget);
+	agent.ruleSet = &ruleSet;
+	agent.SetSeed(1234);
+
+	const double startTime = FPlatformTime::Seconds();
+	const int64 iterations = agent.RunSearch(startingState);
+	const double elapsed = FMath::Max(FPlatformTime::Seconds() - startTime, 1e-6);
+	return iterations / elapsed;
+}
+
+void FMCTSBenchmark::Dispatch(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int iterationBudget)
+{
+	UE_LOG(LogTemp, Display, TEXT("******MCTS Dispatch (%d iterations)***********"), iterationBudget);
+
+	IMCTSSearchRuleSet& virtualRuleSet = ruleSet;
+	const double virtualRate = TimeSearch<UMCTSAgent>(virtualRuleSet, startingState, iterationBudget);
+	const double staticRate = TimeSearch<FMCTSBattleAgent>(ruleSet, startingState, iterationBudget);
+
+	UE_LOG(LogTemp, Display, TEXT("UMCTSAgent (virtual): %.1f it/s"), virtualRate);
+	UE_LOG(LogTemp, Display, TEXT("FMCTSBattleAgent (static): %.1f it/s (x%.2f)"), staticRate, virtualRate > 0.0 ? staticRate / virtualRate : 0.0);
+}
+
+// Applies jumps[i % jumps.Num()] to state, count times, returning ns per jump. checksum keeps the results alive.
+static double TimeJumps(FMCTSBattleRuleset& ruleSet, const FMCTSSearchState& state, const FMCTSMoveList& jumps, int count, float& checksum)
+{
+	FMCTSRandom random(1234);
+	checksum = 0.0f;
+
+	const double startTime = FPlatformTime::Seconds();
+	for (int jump = 0; jump < count; jump++) {
+		const FMCTSSearchState resultingState = ruleSet.NextState(state, jumps[jump % jumps.Num()], random);
+		checksum += resultingState.monsters[0].atk + resultingState.monsters[1].atk + resultingState.platforms[resultingState.monsters[state.actingPlayerIndex].cell].temp;
+	}
+	const double elapsed = FMath::Max(FPlatformTime::Seconds() - startTime, 1e-9);
+	return elapsed * 1e9 / FMath::Max(count, 1);
+}
+
+void FMCTSBenchmark::JumpReactions(const FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int jumps)
+{
+	// Every platform freezes, ignites and floods, so each jump runs all three reactions.
+	FMCTSSearchState quietState = FMCTSSearchState::FromGameState(startingState);
+	FMCTSSearchState reactiveState = quietState;
+	for (int platform = 0; platform < FMCTSSearchState::NumPlatforms; platform++) {
+		quietState.platforms[platform].ClearStatuses();
+		reactiveState.platforms[platform].ClearStatuses();
+		reactiveState.platforms[platform].AddStatus(EMCTSPlatformStatusTypes::Freeze);
+		reactiveState.platforms[platform].AddStatus(EMCTSPlatformStatusTypes::Ignite);
+		reactiveState.platforms[platform].AddStatus(EMCTSPlatformStatusTypes::Flood);
+	}
+
+	FMCTSBattleRuleset inlineRules = ruleSet;
+	inlineRules.SetInlineReactions(true);
+	FMCTSBattleRuleset systemMoveRules = ruleSet;
+	systemMoveRules.SetInlineReactions(false);
+
+	FMCTSMoveList moves;
+	FMCTSMoveList jumpMoves;
+	inlineRules.EnumerateMoves(reactiveState, moves);
+	for (FMCTSMoveId move : moves) {
+		if (move.GetMoveIndex() == 0)
+			jumpMoves.Add(move);
+	}
+	if (jumpMoves.IsEmpty()) {
+		UE_LOG(LogTemp, Warning, TEXT("JumpReactions: the acting monster can't jump from this state."));
+		return;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("******MCTS Jump Reactions (%d jumps over %d targets)***********"), jumps, jumpMoves.Num());
+
+	float quietChecksum, systemMoveChecksum, inlineChecksum;
+	const double quietTime = TimeJumps(inlineRules, quietState, jumpMoves, jumps, quietChecksum);
+	const double systemMoveTime = TimeJumps(systemMoveRules, reactiveState, jumpMoves, jumps, systemMoveChecksum);
+	const double inlineTime = TimeJumps(inlineRules, reactiveState, jumpMoves, jumps, inlineChecksum);
+
+	UE_LOG(LogTemp, Display, TEXT("    no reactions: %.1f ns/jump"), quietTime);
+	UE_LOG(LogTemp, Display, TEXT("    system moves: %.1f ns/jump (x%.2f)"), systemMoveTime, quietTime > 0.0 ? systemMoveTime / quietTime : 0.0);
+	UE_LOG(LogTemp, Display, TEXT("          inline: %.1f ns/jump (x%.2f), %.2fx faster than system moves"),
+		inlineTime, quietTime > 0.0 ? inlineTime / quietTime : 0.0, inlineTime > 0.0 ? systemMoveTime / inlineTime : 0.0);
+	if (systemMoveChecksum != inlineChecksum)
+		UE_LOG(LogTemp, Warning, TEXT("JumpReactions: inline reactions gave different states (%f vs %f)."), inlineChecksum, systemMoveChecksum);
+}
+
+// Plays games from state to the end, greedyPlayers (a bit per player) choosing with FMCTSBattleGreedyPolicy and the
+// others at random. Wins and the average final lead are the given player's; returns playouts/sec.
+static double RunPolicyGames(FMCTSBattleRuleset& ruleSet, const FMCTSSearchState& state, int games, int greedyPlayers, int playerIndex, int32& outWins, double& outLead)
+{
+	const int maxDepth = 150; // UMCTSAgent's default maxSimulationDepth
+	FMCTSRandom random(1234);
+	FMCTSMoveList moves;
+	outWins = 0;
+	outLead = 0.0;
+
+	const double startTime = FPlatformTime::Seconds();
+	for (int game = 0; game < games; game++) {
+		FMCTSSearchState currentState = state;
+		for (int depth = 0; depth < maxDepth && !ruleSet.IsTerminalState(currentState); depth++) {
+			ruleSet.EnumerateMoves(currentState, moves);
+			const int32 moveIndex = (greedyPlayers & (1 << currentState.actingPlayerIndex)) ?
+				FMCTSBattleGreedyPolicy::ChoosePlayoutMove(ruleSet, currentState, moves, random) :
+				FMCTSDefaultPolicy::ChoosePlayoutMove(ruleSet, currentState, moves, random);
+			ruleSet.ApplyMove(currentState, moves[moveIndex], random);
+		}
+		outWins += ruleSet.EvaluateTerminalState(currentState, playerIndex) ? 1 : 0;
+		outLead += ruleSet.PlatformLead(currentState, playerIndex);
+	}
+	const double elapsed = FMath::Max(FPlatformTime::Seconds() - startTime, 1e-6);
+	outLead /= FMath::Max(games, 1);
+	return games / elapsed;
+}
+
+// First move a fresh single-threaded agent decides on (packed), adding its iterations/sec to rate. configure gets the
+// agent before it searches, to turn on whatever is being compared.
+template<typename TConfigure>
+static uint32 DecideWith(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int iterationBudget, int32 seed, double& rate, TConfigure&& configure)
+{
+	FMCTSBattleAgent agent = FMCTSBattleAgent(iterationBudget);
+	agent.ruleSet = &ruleSet;
+	agent.SetSeed(seed);
+	configure(agent);
+
+	const double startTime = FPlatformTime::Seconds();
+	const TArray<FMCTSMove> moves = agent.Decide(startingState, startingState.actingPlayerIndex);
+	const double elapsed = FMath::Max(FPlatformTime::Seconds() - startTime, 1e-6);
+	rate += agent.GetSearchStats().lastSearchIterations / elapsed;
+
+	return moves.IsEmpty() ? 0 : FMCTSMoveId::FromMove(moves[0]).packed;
+}
+
+// Plays a game from state to the end, playerIndex deciding every move with a fresh agent set up by configure and the
+// other player with a plain one on referenceBudget. Returns playerIndex's final PlatformLead and whether they won.
+template<typename TConfigure>
+static float PlayAgainstReference(FMCTSBattleRuleset& ruleSet, const FMCTSSearchState& state, int iterationBudget, int referenceBudget, int playerIndex, int32 seed, bool& bOutWon, TConfigure&& configure)
+{
+	const int maxDepth = 150; // Same as RunPolicyGames
+	FMCTSRandom random(seed);
+	FMCTSMoveList moves;
+	double unusedRate = 0.0;
+
+	FMCTSSearchState currentState = state;
+	for (int depth = 0; depth < maxDepth && !ruleSet.IsTerminalState(currentState); depth++) {
+		const FMCTSGameState gameState = currentState.ToGameState();
+		const int32 decisionSeed = seed * maxDepth + depth;
+		const FMCTSMoveId move = FMCTSMoveId(currentState.actingPlayerIndex == playerIndex ?
+			DecideWith(ruleSet, gameState, iterationBudget, decisionSeed, unusedRate, configure) :
+			DecideWith(ruleSet, gameState, referenceBudget, decisionSeed, unusedRate, [](FMCTSBattleAgent&) {}));
+
+		ruleSet.EnumerateMoves(currentState, moves);
+		ruleSet.ApplyMove(currentState, moves.Contains(move) ? move : FMCTSMoveId::EndTurn(currentState.actingPlayerIndex), random);
+	}
+
+	bOutWon = ruleSet.EvaluateTerminalState(currentState, playerIndex);
+	return ruleSet.PlatformLead(currentState, playerIndex);
+}
+
+void FMCTSBenchmark::PlayoutCutoff(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int iterationBudget)
+{
+	const FMCTSSearchState searchState = FMCTSSearchState::FromGameState(startingState);
+	const int cutoffs[] = { 0, 4, 8, 16 };
+	const int32 seeds = 5;
+
+	UE_LOG(LogTemp, Display, TEXT("******MCTS Playout Cutoff (%d iterations, %d seeds)***********"), iterationBudget, seeds);
+
+	// What a cut-off playout pays at the end instead of playing on.
+	const int evaluations = 100000;
+	float checksum = 0.0f;
+	double startTime = FPlatformTime::Seconds();
+	for (int evaluation = 0; evaluation < evaluations; evaluation++)
+		checksum += ruleSet.EvaluateState(searchState, evaluation & 1);
+	const double evaluateTime = (FPlatformTime::Seconds() - startTime) * 1e9 / evaluations;
+
+	int32 wins;
+	double lead;
+	const double playoutTime = 1e9 / RunPolicyGames(ruleSet, searchState, 1000, 0, 0, wins, lead);
+	checksum += wins;
+
+	UE_LOG(LogTemp, Display, TEXT("EvaluateState: %.1f ns, full playout: %.1f ns (x%.1f) [%f]"),
+		evaluateTime, playoutTime, evaluateTime > 0.0 ? playoutTime / evaluateTime : 0.0, checksum);
+
+	// The move a much longer full-playout search settles on stands in for the right one.
+	double referenceRate = 0.0;
+	TArray<uint32> referenceMoves;
+	for (int32 seed = 0; seed < seeds; seed++)
+		referenceMoves.Add(DecideWith(ruleSet, startingState, iterationBudget * 4, 1000 + seed, referenceRate, [](FMCTSBattleAgent&) {}));
+
+	double fullRate = 0.0;
+	for (int cutoff : cutoffs) {
+		const auto configure = [cutoff](FMCTSBattleAgent& agent) { agent.SetPlayoutCutoff(cutoff); };
+		double rate = 0.0;
+		int32 agreements = 0;
+		for (int32 seed = 0; seed < seeds; seed++) {
+			if (referenceMoves.Contains(DecideWith(ruleSet, startingState, iterationBudget, seed, rate, configure)))
+				agreements++;
+		}
+		rate /= seeds;
+		if (cutoff == 0)
+			fullRate = rate;
+
+		// Agreeing on the first move says little if the moves are close, so also play whole games against the reference
+		// search, taking turns at going first.
+		int32 wins = 0;
+		double lead = 0.0;
+		for (int32 seed = 0; seed < seeds; seed++) {
+			bool bWon;
+			lead += PlayAgainstReference(ruleSet, searchState, iterationBudget, iterationBudget * 4, seed & 1, seed, bWon, configure);
+			wins += bWon ? 1 : 0;
+		}
+		lead /= seeds;
+
+		UE_LOG(LogTemp, Display, TEXT("cutoff %2d%s: %.1f it/s (x%.2f), %d/%d decisions match the reference search, %d/%d wins against it, PlatformLead %+.2f"),
+			cutoff, cutoff == 0 ? TEXT(" (full playouts)") : TEXT(""), rate, fullRate > 0.0 ? rate / fullRate : 0.0, agreements, seeds, wins, seeds, lead);
+	}
+}
+
+void FMCTSBenchmark::PlayoutPolicy(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int playouts)
+{
+	const FMCTSSearchState searchState = FMCTSSearchState::FromGameState(startingState);
+
+	UE_LOG(LogTemp, Display, TEXT("******MCTS Playout Policy (%d playouts, epsilon %.2f)***********"), playouts, FMCTSBattleGreedyPolicy::Epsilon);
+
+	int32 wins;
+	double lead;
+	const double randomRate = RunPolicyGames(ruleSet, searchState, playouts, 0, 0, wins, lead);
+	UE_LOG(LogTemp, Display, TEXT("random vs random: %.1f playouts/s, player 0 wins %.3f, PlatformLead %+.2f"),
+		randomRate, playouts > 0 ? static_cast<float>(wins) / playouts : 0.0f, lead);
+	const double greedyRate = RunPolicyGames(ruleSet, searchState, playouts, 3, 0, wins, lead);
+	UE_LOG(LogTemp, Display, TEXT("greedy vs greedy: %.1f playouts/s (x%.2f)"), greedyRate, randomRate > 0.0 ? greedyRate / randomRate : 0.0);
+
+	// Greedy as each player in turn, against random.
+	for (int greedyPlayer = 0; greedyPlayer < 2; greedyPlayer++) {
+		RunPolicyGames(ruleSet, searchState, playouts, 1 << greedyPlayer, greedyPlayer, wins, lead);
+		UE_LOG(LogTemp, Display, TEXT("greedy as player %d vs random: greedy wins %.3f, PlatformLead %+.2f"),
+			greedyPlayer, playouts > 0 ? static_cast<float>(wins) / playouts : 0.0f, lead);
+	}
+}
+
+void FMCTSBenchmark::Rave(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int raveEquivalence)
+{
+	const int budgets[] = { 100, 500, 2000 };
+	const int referenceBudget = 20000;
+	const int32 referenceSeeds = 3;
+	const int32 seeds = 10;
+
+	UE_LOG(LogTemp, Display, TEXT("******MCTS RAVE (equivalence %d, %d seeds)***********"), raveEquivalence, seeds);
+
+	// Whatever a long plain search settles on stands in for the right move.
+	double referenceRate = 0.0;
+	TArray<uint32> referenceMoves;
+	for (int32 seed = 0; seed < referenceSeeds; seed++)
+		referenceMoves.AddUnique(DecideWith(ruleSet, startingState, referenceBudget, 1000 + seed, referenceRate, [](FMCTSBattleAgent&) {}));
+
+	for (int budget : budgets) {
+		for (int equivalence : { 0, raveEquivalence }) {
+			double rate = 0.0;
+			int32 agreements = 0;
+			for (int32 seed = 0; seed < seeds; seed++) {
+				const uint32 move = DecideWith(ruleSet, startingState, budget, seed, rate,
+					[equivalence](FMCTSBattleAgent& agent) { agent.SetRave(equivalence); });
+				if (referenceMoves.Contains(move))
+					agreements++;
+			}
+			UE_LOG(LogTemp, Display, TEXT("%5d iterations %s: %.1f it/s, %d/%d decisions match the reference search"),
+				budget, equivalence > 0 ? TEXT("RAVE ") : TEXT("plain"), rate / seeds, agreements, seeds);
+		}
+	}
+}
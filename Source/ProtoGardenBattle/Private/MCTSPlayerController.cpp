@@ -1,4 +1,137 @@
 #include "MCTSPlayerController.h"
+#include "MCTSBenchmark.h"
+
+AMCTSPlayerController::AMCTSPlayerController()
+    : blueprintRuleSet(this)
+{
+    PrimaryActorTick.bCanEverTick = true;
+}
+
+void AMCTSPlayerController::Tick(float DeltaSeconds)
+{
+    Super::Tick(DeltaSeconds);
+
+    // Don't stall the frame if a DecideNextMove task has the agent, just try again next tick.
+    if (!slicedSearchActive || !agentLock.TryLock())
+        return;
+
+    if (!agent->StepSearch(slicedMicroseconds)) {
+        agentLock.Unlock();
+        return;
+    }
+
+    TArray<FMCTSMove> decision = agent->FinishSearch();
+    slicedSearchActive = false;
+    agentLock.Unlock();
+    StartPondering();
+
+    if (decision.IsEmpty() || decision.Last().moveIndex != -1)
+        decision.Add(FMCTSMove(slicedPlayerIndex));
+
+    for (FMCTSMove move : decision) {
+        // We execute the delegate along with the param
+        slicedOut.ExecuteIfBound(move);
+    }
+}
+
+void AMCTSPlayerController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    // DecideNextMove tasks hold on to this and start pondering when they finish, so stop them from starting any more
+    // and wait for the ones still running before the last ponder task is stopped.
+    shuttingDown = true;
+    while (decisionsInFlight.load() > 0)
+        FPlatformProcess::Sleep(0.001f);
+    StopPondering();
+    Super::EndPlay(EndPlayReason);
+}
+
+IMCTSAgent& AMCTSPlayerController::GetAgent()
+{
+    if (!agent.IsValid()) {
+        if (useBlueprint) {
+            TUniquePtr<UMCTSAgent> blueprintAgent = MakeUnique<UMCTSAgent>(0);
+            blueprintAgent->ruleSet = &blueprintRuleSet;
+            if (searchSeed != 0)
+                blueprintAgent->SetSeed(searchSeed);
+            agent = MoveTemp(blueprintAgent);
+        }
+        else if (greedyPlayouts) {
+            agent = MakeBattleAgent<FMCTSBattleGreedyAgent>();
+        }
+        else {
+            agent = MakeBattleAgent<FMCTSBattleAgent>();
+        }
+    }
+    return *agent;
+}
+
+// Same settings whichever playout policy the agent was compiled with.
+template<typename TBattleAgent>
+TUniquePtr<IMCTSAgent> AMCTSPlayerController::MakeBattleAgent()
+{
+    TUniquePtr<TBattleAgent> battleAgent = MakeUnique<TBattleAgent>(0);
+    battleAgent->ruleSet = &battleRuleSet;
+    battleAgent->SetParallelism(sharedTreeSearch ? EMCTSParallelMode::Tree : EMCTSParallelMode::Root, searchThreads);
+    battleAgent->SetParallelPlayouts(parallelPlayouts);
+    battleAgent->SetCollapseEquivalentMoves(collapseEquivalentMoves);
+    battleAgent->SetTranspositionTable(transpositionTableSizeLog2);
+    battleAgent->SetEndgameSolver(endgameSolverTurns);
+    battleAgent->SetPlayoutCutoff(playoutCutoff);
+    battleAgent->SetRave(raveEquivalence);
+    if (searchSeed != 0)
+        battleAgent->SetSeed(searchSeed);
+    return MoveTemp(battleAgent);
+}
+
+void AMCTSPlayerController::StartPondering()
+{
+    // Blueprint rulesets aren't safe to run off the game thread while nobody is waiting on them.
+    if (!ponderDuringOpponentTurn || useBlueprint)
+        return;
+
+    FScopeLock lock(&ponderLock);
+    if (ponderTask.IsValid() || shuttingDown)
+        return;
+
+    stopPondering = false;
+    ponderTask = Async(EAsyncExecution::ThreadPool, [this]()
+        {
+            FScopeLock agentScope(&agentLock);
+            if (agent.IsValid())
+                agent->Ponder(stopPondering);
+        }
+    );
+}
+
+void AMCTSPlayerController::StopPondering()
+{
+    FScopeLock lock(&ponderLock);
+    if (!ponderTask.IsValid())
+        return;
+
+    stopPondering = true;
+    ponderTask.Wait();
+    ponderTask.Reset();
+}
+
+void AMCTSPlayerController::NotifyOpponentMove(const FMCTSMove& move)
+{
+    StopPondering();
+    {
+        FScopeLock lock(&agentLock);
+        if (agent.IsValid())
+            agent->ObserveMove(move);
+    }
+    StartPondering();
+}
+
+void AMCTSPlayerController::ResetAgent()
+{
+    StopPondering();
+    FScopeLock lock(&agentLock);
+    agent.Reset();
+    slicedSearchActive = false;
+}
 
 void AMCTSPlayerController::SetupBattleMovesets(
     TArray<FGeneratedMove> playerMoveList,
@@ -6,6 +139,9 @@ void AMCTSPlayerController::SetupBattleMovesets(
     TArray<FGeneratedMove> systemMoveList
 )
 {
+    // The old tree was built with the old movesets.
+    ResetAgent();
+
     battleRuleSet = FMCTSBattleRuleset();
     battleRuleSet.IngestMoveSets(playerMoveList, opponentMoveList, systemMoveList);
     useBlueprint = false;
@@ -15,16 +151,29 @@ void AMCTSPlayerController::DecideNextMove(
     FMCTSDelegate Out,
     const FMCTSGameState& inputState, 
     const int playerIndex,
-    const int iterationBudget
+    const int iterationBudget,
+    const float timeBudgetMs
 )
 {
-    AsyncTask(ENamedThreads::AnyHiPriThreadNormalTask, [Out, inputState, playerIndex, iterationBudget, this]()
+    if (shuttingDown)
+        return;
+
+    decisionsInFlight++;
+    AsyncTask(ENamedThreads::AnyHiPriThreadNormalTask, [Out, inputState, playerIndex, iterationBudget, timeBudgetMs, this]()
         {
-            UMCTSAgent agent = UMCTSAgent(iterationBudget);
-            if (useBlueprint)
-                agent.ruleSet = this;
-            else
-                agent.ruleSet = &battleRuleSet;
+            if (shuttingDown) {
+                decisionsInFlight--;
+                return;
+            }
+
+            // The opponent is done, so the search pondering their turn can hand the tree over.
+            StopPondering();
+            FScopeLock lock(&agentLock);
+
+            IMCTSAgent& agent = GetAgent();
+            agent.SetDecisionBudget(iterationBudget);
+            agent.SetTimeBudget(timeBudgetMs);
+            agent.SyncRoot(inputState);
 
             // Keep making decisions until a stop is decided.
             TArray<FMCTSMove> decision = {};
@@ -44,6 +193,10 @@ void AMCTSPlayerController::DecideNextMove(
                 totalDecisionBudget--;
             }
 
+            // The tree is now rooted at the opponent's turn, keep growing it while they think.
+            lock.Unlock();
+            StartPondering();
+            decisionsInFlight--;
         }
     );
 }
@@ -52,12 +205,21 @@ void AMCTSPlayerController::DecideNextMoveSync(
     FMCTSDelegate Out,
     const FMCTSGameState& inputState,
     const int playerIndex,
-    const int iterationBudget
+    const int iterationBudget,
+    const float timeBudgetMs
 )
 {
-    UMCTSAgent agent = UMCTSAgent(iterationBudget);
-    agent.ruleSet = &battleRuleSet;
-    TArray<FMCTSMove> decision = agent.Decide(inputState, playerIndex);
+    StopPondering();
+    TArray<FMCTSMove> decision;
+    {
+        FScopeLock lock(&agentLock);
+        IMCTSAgent& agent = GetAgent();
+        agent.SetDecisionBudget(iterationBudget);
+        agent.SetTimeBudget(timeBudgetMs);
+        agent.SyncRoot(inputState);
+        decision = agent.Decide(inputState, playerIndex);
+    }
+    StartPondering();
 
     if (decision.IsEmpty() || decision.Last().moveIndex != -1)
         decision.Add(FMCTSMove(playerIndex));
@@ -66,4 +228,76 @@ void AMCTSPlayerController::DecideNextMoveSync(
         // We execute the delegate along with the param
         Out.ExecuteIfBound(move);
     }
-}
\ No newline at end of file
+}
+
+void AMCTSPlayerController::DecideNextMoveSliced(
+    FMCTSDelegate Out,
+    const FMCTSGameState& inputState,
+    const int playerIndex,
+    const int iterationBudget,
+    const float sliceMicroseconds,
+    const float timeBudgetMs
+)
+{
+    // A new request replaces any search still in progress.
+    StopPondering();
+    FScopeLock lock(&agentLock);
+    IMCTSAgent& agent = GetAgent();
+    agent.SetDecisionBudget(iterationBudget);
+    agent.SetTimeBudget(timeBudgetMs);
+    agent.SyncRoot(inputState);
+    agent.BeginSearch(inputState, playerIndex);
+
+    slicedSearchActive = true;
+    slicedOut = Out;
+    slicedPlayerIndex = playerIndex;
+    slicedMicroseconds = FMath::Max(sliceMicroseconds, 1.0f);
+}
+
+void AMCTSPlayerController::BenchmarkThreadScaling(
+    const FMCTSGameState& inputState,
+    const int iterationBudget
+)
+{
+    FMCTSBenchmark::ThreadScaling(battleRuleSet, inputState, iterationBudget);
+}
+
+void AMCTSPlayerController::BenchmarkDispatch(
+    const FMCTSGameState& inputState,
+    const int iterationBudget
+)
+{
+    FMCTSBenchmark::Dispatch(battleRuleSet, inputState, iterationBudget);
+}
+
+void AMCTSPlayerController::BenchmarkJumpReactions(
+    const FMCTSGameState& inputState,
+    const int jumps
+)
+{
+    FMCTSBenchmark::JumpReactions(battleRuleSet, inputState, jumps);
+}
+
+void AMCTSPlayerController::BenchmarkPlayoutCutoff(
+    const FMCTSGameState& inputState,
+    const int iterationBudget
+)
+{
+    FMCTSBenchmark::PlayoutCutoff(battleRuleSet, inputState, iterationBudget);
+}
+
+void AMCTSPlayerController::BenchmarkPlayoutPolicy(
+    const FMCTSGameState& inputState,
+    const int playouts
+)
+{
+    FMCTSBenchmark::PlayoutPolicy(battleRuleSet, inputState, playouts);
+}
+
+void AMCTSPlayerController::BenchmarkRave(
+    const FMCTSGameState& inputState,
+    const int raveEquivalence
+)
+{
+    FMCTSBenchmark::Rave(battleRuleSet, inputState, raveEquivalence);
+}
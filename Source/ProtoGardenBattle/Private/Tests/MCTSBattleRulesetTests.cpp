@@ -0,0 +1,870 @@
+#include "Misc/AutomationTest.h"
+#include "MCTSBattleRuleset.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace MCTSBattleRulesetTests
+{
+	typedef EGeneratedMoveEffectTypes EEffect;
+	typedef EGeneratedMoveTargetSelectorTypes ESelector;
+
+	constexpr int32 TestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter;
+
+	static void AddEffectList(FGeneratedMove& move, ESelector selector, std::initializer_list<FGeneratedEffect> effects)
+	{
+		FGeneratedEffectList effectList;
+		for (const FGeneratedEffect& effect : effects)
+			effectList.effects.Add(effect);
+		move.selectors.Add(selector);
+		move.effectLists.Add(effectList);
+	}
+
+	static FGeneratedMove MakeMove(int32 cost, ESelector selector, std::initializer_list<FGeneratedEffect> effects)
+	{
+		FGeneratedMove move;
+		move.cost = cost;
+		AddEffectList(move, selector, effects);
+		return move;
+	}
+
+	// A small moveset that reaches every kind of effect and selector the ruleset handles: jumps, stat and platform
+	// changes, gates and stores, every status, pushes, random targets and two-selector moves.
+	static TArray<FGeneratedMove> MakeMoveList(bool bOpponent)
+	{
+		const float sign = bOpponent ? 1.0f : -1.0f;
+
+		TArray<FGeneratedMove> moves;
+		moves.Add(MakeMove(1, ESelector::Any, { FGeneratedEffect(EEffect::MoveTo, 1) }));
+		moves.Add(MakeMove(1, ESelector::Adjacent, { FGeneratedEffect(EEffect::ChangeTemp, 65 * sign), FGeneratedEffect(EEffect::ChangeAtk, 20) }));
+		moves.Add(MakeMove(2, ESelector::Line3, { FGeneratedEffect(EEffect::GateHum, 30), FGeneratedEffect(EEffect::ChangeHum, -85 * sign), FGeneratedEffect(EEffect::StoreTemp, 50), FGeneratedEffect(EEffect::ChangeElev, 10) }));
+		moves.Add(MakeMove(1, ESelector::Occupied, { FGeneratedEffect(EEffect::ChangeSpd, 15), FGeneratedEffect(EEffect::Freeze, sign), FGeneratedEffect(EEffect::Sandtrap, 1) }));
+		moves.Add(MakeMove(1, ESelector::Opponent, { FGeneratedEffect(EEffect::Lockdown, 1), FGeneratedEffect(EEffect::ChangeDef, -10) }));
+		moves.Add(MakeMove(1, ESelector::RandomAdjacent, { FGeneratedEffect(EEffect::ChangeHum, 30 * sign) }));
+		moves.Add(MakeMove(1, ESelector::AllAdjacent, { FGeneratedEffect(EEffect::ChangeTemp, 40), FGeneratedEffect(EEffect::PullPush, 30) }));
+
+		FGeneratedMove twoSelectors = MakeMove(1, ESelector::Own, { FGeneratedEffect(EEffect::ChangeElev, 30) });
+		AddEffectList(twoSelectors, ESelector::Any, { FGeneratedEffect(EEffect::ChangeElev, -30) });
+		moves.Add(twoSelectors);
+		return moves;
+	}
+
+	// Slip, stamp and splash.
+	static TArray<FGeneratedMove> MakeSystemMoveList()
+	{
+		TArray<FGeneratedMove> moves;
+		moves.Add(MakeMove(0, ESelector::Adjacent, { FGeneratedEffect(EEffect::MoveTo, 1) }));
+		moves.Add(MakeMove(0, ESelector::Own, { FGeneratedEffect(EEffect::ChangeTemp, -20) }));
+		moves.Add(MakeMove(0, ESelector::AllAdjacent, { FGeneratedEffect(EEffect::ChangeHum, 20) }));
+		return moves;
+	}
+
+	// Without bRandomTargets the random-target move is left out, so every move has a single outcome.
+	static void IngestTestMoveSets(FMCTSBattleRuleset& ruleSet, bool bRandomTargets = true)
+	{
+		TArray<FGeneratedMove> playerMoves = MakeMoveList(false);
+		TArray<FGeneratedMove> opponentMoves = MakeMoveList(true);
+		if (!bRandomTargets) {
+			const auto isRandom = [](const FGeneratedMove& move) { return move.selectors[0] == ESelector::RandomAdjacent; };
+			playerMoves.RemoveAll(isRandom);
+			opponentMoves.RemoveAll(isRandom);
+		}
+		ruleSet.IngestMoveSets(playerMoves, opponentMoves, MakeSystemMoveList());
+	}
+
+	// Monsters in opposite corners on a board with a spread of conditions, and a few statuses down so the first jumps
+	// already set off reactions.
+	static FMCTSSearchState MakeStartingState()
+	{
+		FMCTSSearchState state;
+		for (int32 m = 0; m < FMCTSSearchState::NumMonsters; m++) {
+			FMCTSSearchMonster& monster = state.monsters[m];
+			monster.id = m;
+			monster.atk = 50.0f;
+			monster.def = 40.0f + m * 10.0f;
+			monster.spd = 50.0f - m * 5.0f;
+			monster.temp = 0.3f + m * 0.2f;
+			monster.hum = 0.5f;
+			monster.elev = 0.4f;
+			monster.ap = 2;
+			monster.score = 50.0f;
+			monster.cell = m ? 8 : 0;
+		}
+		for (int32 p = 0; p < FMCTSSearchState::NumPlatforms; p++) {
+			state.platforms[p].temp = p / 9.0f;
+			state.platforms[p].hum = 1.0f - p / 10.0f;
+			state.platforms[p].elev = 0.5f;
+		}
+		state.platforms[2].AppendStatus(EMCTSPlatformStatusTypes::Ignite);
+		state.platforms[4].AppendStatus(EMCTSPlatformStatusTypes::Flood);
+		state.platforms[4].AppendStatus(EMCTSPlatformStatusTypes::Freeze);
+		state.platforms[6].AppendStatus(EMCTSPlatformStatusTypes::Freeze);
+		return state;
+	}
+
+	// Field by field, floats compared exactly: "close" isn't good enough for a state the search walks back up to.
+	static bool IsSameState(const FMCTSSearchState& a, const FMCTSSearchState& b)
+	{
+		if (a.turnCount != b.turnCount || a.actingPlayerIndex != b.actingPlayerIndex)
+			return false;
+
+		for (int32 m = 0; m < FMCTSSearchState::NumMonsters; m++) {
+			const FMCTSSearchMonster& x = a.monsters[m];
+			const FMCTSSearchMonster& y = b.monsters[m];
+			if (x.id != y.id || x.atk != y.atk || x.def != y.def || x.spd != y.spd || x.temp != y.temp || x.hum != y.hum
+				|| x.elev != y.elev || x.ap != y.ap || x.score != y.score || x.cell != y.cell)
+				return false;
+		}
+
+		for (int32 p = 0; p < FMCTSSearchState::NumPlatforms; p++) {
+			const FMCTSSearchPlatform& x = a.platforms[p];
+			const FMCTSSearchPlatform& y = b.platforms[p];
+			if (x.temp != y.temp || x.hum != y.hum || x.elev != y.elev || x.statuses != y.statuses || x.statusOrder != y.statusOrder)
+				return false;
+		}
+		return true;
+	}
+
+	// Plays random moves from the starting state until the slower monster is on its last move of the game.
+	static FMCTSSearchState MakeLastMoveState(FMCTSBattleRuleset& ruleSet, FMCTSRandom& random)
+	{
+		FMCTSSearchState state = MakeStartingState();
+		FMCTSMoveList moves;
+		for (;;) {
+			const FMCTSSearchMonster& acting = state.monsters[state.actingPlayerIndex];
+			const FMCTSSearchMonster& waiting = state.monsters[1 - state.actingPlayerIndex];
+			if (ruleSet.TurnsRemaining(state) == 1 && !(acting.spd > waiting.spd) && acting.ap <= 1)
+				return state;
+
+			ruleSet.EnumerateMoves(state, moves);
+			ruleSet.ApplyMove(state, moves[random.RandRange(0, moves.Num() - 1)], random);
+			if (ruleSet.IsTerminalState(state))
+				state = MakeStartingState();
+		}
+	}
+
+	// Game value of the state for the player to move, by trying every move, or Unknown if that takes more than depth
+	// moves, more than budget positions or a move with a random outcome.
+	static EMCTSProof SolveByHand(FMCTSBattleRuleset& ruleSet, const FMCTSSearchState& state, int32 depth, int32& budget)
+	{
+		if (ruleSet.IsTerminalState(state)) {
+			if (ruleSet.EvaluateTerminalState(state, state.actingPlayerIndex))
+				return EMCTSProof::Win;
+			return ruleSet.EvaluateTerminalState(state, 1 - state.actingPlayerIndex) ? EMCTSProof::Loss : EMCTSProof::Draw;
+		}
+		if (depth == 0 || --budget < 0)
+			return EMCTSProof::Unknown;
+
+		FMCTSMoveList moves;
+		ruleSet.EnumerateMoves(state, moves);
+		bool bAllKnown = true;
+		bool bCanDraw = false;
+		for (const FMCTSMoveId move : moves) {
+			if (ruleSet.HasRandomOutcome(state, move)) {
+				bAllKnown = false;
+				continue;
+			}
+
+			FMCTSRandom unused;
+			const FMCTSSearchState child = ruleSet.NextState(state, move, unused);
+			EMCTSProof value = SolveByHand(ruleSet, child, depth - 1, budget);
+			if (child.actingPlayerIndex != state.actingPlayerIndex)
+				value = value == EMCTSProof::Win ? EMCTSProof::Loss : (value == EMCTSProof::Loss ? EMCTSProof::Win : value);
+
+			if (value == EMCTSProof::Win)
+				return value;
+			bAllKnown &= value != EMCTSProof::Unknown;
+			bCanDraw |= value == EMCTSProof::Draw;
+		}
+		if (!bAllKnown)
+			return EMCTSProof::Unknown;
+		return bCanDraw ? EMCTSProof::Draw : EMCTSProof::Loss;
+	}
+
+	// Checks every proven node under node against SolveByHand, where that comes out known.
+	static void CheckProofs(FMCTSBattleRuleset& ruleSet, const UMCTSNode* node, int32& outSolved, int32& outChecked, int32& outWrong)
+	{
+		if (node->IsSolved()) {
+			outSolved++;
+			int32 budget = 200000;
+			const EMCTSProof byHand = SolveByHand(ruleSet, node->state, 12, budget);
+			if (byHand != EMCTSProof::Unknown) {
+				outChecked++;
+				outWrong += byHand != node->GetProof() ? 1 : 0;
+			}
+		}
+		for (int32 childIndex = 0; childIndex < node->NumExpandedChildren(); childIndex++)
+			CheckProofs(ruleSet, node->GetChild(childIndex), outSolved, outChecked, outWrong);
+	}
+
+	// Checks that every node under node holds no wins if the loser moves there, and some once visited if the winner does.
+	// (Wins can't be checked against visits exactly: a node's first playouts come in before it's ever selected.)
+	static void CheckWinsForWinner(const UMCTSNode* node, int32 winner, int32& outChecked, int32& outWrong)
+	{
+		if (node->state.actingPlayerIndex != winner) {
+			outChecked++;
+			outWrong += node->WinCount() != 0 ? 1 : 0;
+		}
+		else if (node->SelectionCount() > 0) {
+			outChecked++;
+			outWrong += node->WinCount() == 0 ? 1 : 0;
+		}
+		for (int32 childIndex = 0; childIndex < node->NumExpandedChildren(); childIndex++)
+			CheckWinsForWinner(node->GetChild(childIndex), winner, outChecked, outWrong);
+	}
+
+	// AMAF counts as they should be after a search whose every playout the winner won: in range, and all or nothing
+	// for the player each slot's move leads to, the same player the slot's own wins are for. Zero when RAVE is off.
+	static void CheckAmafForWinner(const UMCTSNode* node, int32 winner, bool bRave, int32& outChecked, int32& outWrong)
+	{
+		const FMCTSChildStats& stats = node->childStats;
+		const int32 numExpanded = node->NumExpandedChildren();
+		for (int32 childIndex = 0; childIndex < node->moves.Num(); childIndex++) {
+			const int32 amafVisits = stats.amafVisits[childIndex].load();
+			const int32 amafWins = stats.amafWins[childIndex].load();
+			const int32 movePlayerIndex = childIndex < numExpanded
+				? node->GetChild(childIndex)->state.actingPlayerIndex
+				: (node->moves[childIndex].IsEndTurn() ? 1 - node->state.actingPlayerIndex : node->state.actingPlayerIndex);
+			const int32 expectedWins = bRave && movePlayerIndex == winner ? amafVisits * FMCTSChildStats::WinScale : 0;
+			outChecked += amafVisits > 0 ? 1 : 0;
+			outWrong += amafVisits < 0 || (!bRave && amafVisits != 0) || amafWins != expectedWins ? 1 : 0;
+		}
+		for (int32 childIndex = 0; childIndex < numExpanded; childIndex++)
+			CheckAmafForWinner(node->GetChild(childIndex), winner, bRave, outChecked, outWrong);
+	}
+
+	// Same states, moves, visits, wins and proofs at every node, all the way down.
+	static bool IsSameTree(const UMCTSNode* a, const UMCTSNode* b)
+	{
+		if (!a || !b)
+			return a == b;
+		if (!IsSameState(a->state, b->state) || a->SelectionCount() != b->SelectionCount() || a->WinCount() != b->WinCount() || a->GetProof() != b->GetProof()
+			|| a->moves != b->moves || a->NumExpandedChildren() != b->NumExpandedChildren())
+			return false;
+
+		for (int32 childIndex = 0; childIndex < a->NumExpandedChildren(); childIndex++) {
+			if (!IsSameTree(a->GetChild(childIndex), b->GetChild(childIndex)))
+				return false;
+		}
+		return true;
+	}
+
+	// Grows a tree from the starting state on a fresh agent, returning the number of iterations.
+	// Playouts are cut off and scored by EvaluateState, since full games all end on the starting scores and would
+	// leave every win count at 0 whatever the seed.
+	template<typename TAgent, typename TRuleSet>
+	static int64 SearchFromStart(TAgent& agent, TRuleSet& ruleSet, int32 seed, int32 searchThreads = 1)
+	{
+		agent.ruleSet = &ruleSet;
+		agent.SetPlayoutCutoff(8);
+		agent.SetParallelism(searchThreads > 1 ? EMCTSParallelMode::Root : EMCTSParallelMode::Single, searchThreads);
+		agent.SetSeed(seed);
+		return agent.RunSearch(MakeStartingState());
+	}
+	// Every selector, and gates and stores both fused (followed by a plain effect) and not (followed by another gate
+	// or store, or last in the list), with powers that don't divide by 100 exactly.
+	static TArray<FGeneratedMove> MakeEffectProgramMoveList(bool bOpponent)
+	{
+		const float sign = bOpponent ? 1.0f : -1.0f;
+
+		TArray<FGeneratedMove> moves;
+		moves.Add(MakeMove(1, ESelector::Any, { FGeneratedEffect(EEffect::MoveTo, 1) }));
+		moves.Add(MakeMove(1, ESelector::Adjacent, { FGeneratedEffect(EEffect::GateTemp, 40), FGeneratedEffect(EEffect::ChangeTemp, 33 * sign), FGeneratedEffect(EEffect::ChangeAtk, 12.5f) }));
+		moves.Add(MakeMove(1, ESelector::RandomAny, { FGeneratedEffect(EEffect::GateHum, -45), FGeneratedEffect(EEffect::ChangeHum, -27 * sign) }));
+		moves.Add(MakeMove(1, ESelector::RandomOccupied, { FGeneratedEffect(EEffect::StoreElev, 70), FGeneratedEffect(EEffect::ChangeElev, 10), FGeneratedEffect(EEffect::ChangeDef, 7.5f) }));
+		moves.Add(MakeMove(1, ESelector::RandomAdjacent, { FGeneratedEffect(EEffect::GateTemp, 60), FGeneratedEffect(EEffect::GateHum, 30), FGeneratedEffect(EEffect::ChangeHum, 21) }));
+		moves.Add(MakeMove(2, ESelector::Occupied, { FGeneratedEffect(EEffect::StoreTemp, 50), FGeneratedEffect(EEffect::StoreHum, 40), FGeneratedEffect(EEffect::ChangeTemp, -15 * sign) }));
+		moves.Add(MakeMove(1, ESelector::Opponent, { FGeneratedEffect(EEffect::GateElev, 55), FGeneratedEffect(EEffect::StoreTemp, 35), FGeneratedEffect(EEffect::ChangeSpd, 9), FGeneratedEffect(EEffect::Lockdown, 1) }));
+		moves.Add(MakeMove(1, ESelector::Own, { FGeneratedEffect(EEffect::ChangeElev, -18), FGeneratedEffect(EEffect::StoreHum, 25) }));
+		moves.Add(MakeMove(1, ESelector::Line2, { FGeneratedEffect(EEffect::Freeze, sign), FGeneratedEffect(EEffect::Sandtrap, -sign), FGeneratedEffect(EEffect::GateElev, 20) }));
+		moves.Add(MakeMove(2, ESelector::Line3, { FGeneratedEffect(EEffect::StoreTemp, 60), FGeneratedEffect(EEffect::GateTemp, 30), FGeneratedEffect(EEffect::ChangeTemp, 44) }));
+		moves.Add(MakeMove(1, ESelector::AllAdjacent, { FGeneratedEffect(EEffect::PullPush, 30 * sign), FGeneratedEffect(EEffect::ChangeTemp, 25), FGeneratedEffect(EEffect::Lockdown, -1) }));
+
+		FGeneratedMove twoSelectors = MakeMove(1, ESelector::Own, { FGeneratedEffect(EEffect::ChangeElev, 30) });
+		AddEffectList(twoSelectors, ESelector::Any, { FGeneratedEffect(EEffect::GateHum, 50), FGeneratedEffect(EEffect::ChangeHum, -30) });
+		moves.Add(twoSelectors);
+		return moves;
+	}
+
+	// The rules as NextState ran them before IngestMoveSets compiled anything: each FGeneratedEffect walked straight
+	// off the FGeneratedMove with gates and stores as pending flags, and powers divided by 100 as they're read. Kept to
+	// the old code line for line, only on cells instead of FVector2D positions, so the compiled programs can be held to
+	// exactly the same results.
+	struct FReferenceRules
+	{
+		TArray<FGeneratedMove> playerMoves;
+		TArray<FGeneratedMove> opponentMoves;
+		TArray<FGeneratedMove> systemMoves;
+
+		static void FillTargets(ESelector selector, uint8 target, uint8 own, uint8 opponent, FMCTSRandom& random, TArray<uint8>& newTargets)
+		{
+			const int32 offsets[4][2] = { {1,0}, {0,1}, {-1,0}, {0,-1} };
+			const auto step = [](uint8 from, int32 dx, int32 dy) {
+				return FMCTSSearchState::MakeCell(FMCTSSearchState::CellX(from) + dx, FMCTSSearchState::CellY(from) + dy);
+			};
+			const int32 dx = FMCTSSearchState::CellX(target) - FMCTSSearchState::CellX(own);
+			const int32 dy = FMCTSSearchState::CellY(target) - FMCTSSearchState::CellY(own);
+
+			// Falls through from case to case, as it always has.
+			switch (selector) {
+			case ESelector::RandomAny:
+				newTargets.Add(static_cast<uint8>(random.RandRange(0, 8)));
+			case ESelector::RandomOccupied:
+				newTargets.Add(random.RandRange(0, 1) == 0 ? own : opponent);
+			case ESelector::RandomAdjacent: {
+				const int32 choice = random.RandRange(0, 3);
+				const uint8 adjacent = step(own, offsets[choice][0], offsets[choice][1]);
+				if (adjacent != own)
+					newTargets.AddUnique(adjacent);
+			}
+			case ESelector::Opponent:
+				newTargets.Add(opponent);
+			case ESelector::Own:
+				newTargets.Add(own);
+			case ESelector::Line2:
+				newTargets.Add(target);
+				newTargets.AddUnique(step(target, dx, dy));
+			case ESelector::Line3: {
+				const uint8 newPoint = step(target, dx, dy);
+				newTargets.Add(target);
+				newTargets.AddUnique(newPoint);
+				newTargets.AddUnique(step(newPoint, dx, dy));
+			}
+			case ESelector::AllAdjacent:
+				for (const auto& offset : offsets) {
+					const uint8 adjacent = step(own, offset[0], offset[1]);
+					if (adjacent != own)
+						newTargets.AddUnique(adjacent);
+				}
+			default:
+				newTargets.Add(target);
+			}
+		}
+
+		static FMCTSSearchPlatform ChangePlatform(FMCTSSearchPlatform platform, EEffect type, float power)
+		{
+			switch (type) {
+			case EEffect::ChangeTemp:
+				platform.temp = FMath::Clamp(platform.temp + power, 0.0f, 1.0f);
+				if (platform.temp >= 1.0f)
+					platform.AddStatus(EMCTSPlatformStatusTypes::Ignite);
+				else if (power < 0)
+					platform.RemoveStatus(EMCTSPlatformStatusTypes::Ignite);
+				if (platform.temp <= 0.0f)
+					platform.AddStatus(EMCTSPlatformStatusTypes::Freeze);
+				else if (power > 0)
+					platform.RemoveStatus(EMCTSPlatformStatusTypes::Freeze);
+				break;
+			case EEffect::ChangeHum:
+				platform.hum = FMath::Clamp(platform.hum + power, 0.0f, 1.0f);
+				if (platform.hum >= 1.0f)
+					platform.AddStatus(EMCTSPlatformStatusTypes::Flood);
+				else if (power < 0)
+					platform.RemoveStatus(EMCTSPlatformStatusTypes::Flood);
+				if (platform.hum <= 0.0f)
+					platform.AddStatus(EMCTSPlatformStatusTypes::Sandtrap);
+				else if (power > 0)
+					platform.RemoveStatus(EMCTSPlatformStatusTypes::Sandtrap);
+				break;
+			case EEffect::ChangeElev:
+				platform.elev = FMath::Clamp(platform.elev + power, 0.0f, 1.0f);
+				break;
+			case EEffect::Lockdown:
+			case EEffect::Freeze:
+			case EEffect::Sandtrap: {
+				const EMCTSPlatformStatusTypes status = type == EEffect::Lockdown ? EMCTSPlatformStatusTypes::Lockdown :
+					(type == EEffect::Freeze ? EMCTSPlatformStatusTypes::Freeze : EMCTSPlatformStatusTypes::Sandtrap);
+				if (power > 0)
+					platform.AppendStatus(status);
+				else
+					platform.RemoveStatus(status);
+				break;
+			}
+			default:
+				break;
+			}
+			return platform;
+		}
+
+		static FMCTSSearchMonster ChangeMonster(FMCTSSearchMonster monster, uint8 targetCell, EEffect type, float power)
+		{
+			switch (type) {
+			case EEffect::ChangeAtk: monster.atk += FGenericPlatformMath::Max(0.0f, power * 100.0f); break;
+			case EEffect::ChangeDef: monster.def += FGenericPlatformMath::Max(0.0f, power * 100.0f); break;
+			case EEffect::ChangeSpd: monster.spd += FGenericPlatformMath::Max(0.0f, power * 100.0f); break;
+			case EEffect::PullPush:
+			case EEffect::MoveTo: monster.cell = targetCell; break;
+			default: break;
+			}
+			return monster;
+		}
+
+		static void RunEffects(const FGeneratedEffectList& effectList, int32 castersIndex, uint8 targetCell, FMCTSSearchState& state)
+		{
+			const int32 opponentsIndex = 1 - castersIndex;
+			bool gateNextEffect = false;
+			bool overwriteNextEffectPower = false;
+			float storedEffectPower = 0;
+			for (const FGeneratedEffect& effect : effectList.effects) {
+				float power = effect.power;
+				if (gateNextEffect) {
+					gateNextEffect = false;
+					continue;
+				}
+				if (overwriteNextEffectPower) {
+					overwriteNextEffectPower = false;
+					power = storedEffectPower;
+				}
+
+				power = power / 100.0f;
+				const float modulated = power * ((state.monsters[castersIndex].atk * 0.01f) + 0.5f);
+				FMCTSSearchPlatform& platform = state.platforms[targetCell];
+				switch (effect.type) {
+				case EEffect::ChangeTemp:
+				case EEffect::ChangeHum:
+				case EEffect::ChangeElev:
+				case EEffect::Lockdown:
+				case EEffect::Freeze:
+				case EEffect::Sandtrap:
+					platform = ChangePlatform(platform, effect.type, modulated);
+					break;
+				case EEffect::StoreTemp: storedEffectPower = platform.temp * modulated; overwriteNextEffectPower = true; break;
+				case EEffect::StoreHum: storedEffectPower = platform.hum * modulated; overwriteNextEffectPower = true; break;
+				case EEffect::StoreElev: storedEffectPower = platform.elev * modulated; overwriteNextEffectPower = true; break;
+				case EEffect::GateTemp: gateNextEffect = power < 0 ? platform.temp >= -power : platform.temp <= power; break;
+				case EEffect::GateHum: gateNextEffect = power < 0 ? platform.hum >= -power : platform.hum <= power; break;
+				case EEffect::GateElev: gateNextEffect = power < 0 ? platform.elev >= -power : platform.elev <= power; break;
+				case EEffect::ChangeAtk:
+				case EEffect::ChangeDef:
+				case EEffect::ChangeSpd:
+					for (FMCTSSearchMonster& monster : state.monsters) {
+						if (monster.cell == targetCell)
+							monster = ChangeMonster(monster, targetCell, effect.type, modulated);
+					}
+					break;
+				case EEffect::PullPush: {
+					const FVector2D position = FMCTSSearchState::PositionOf(state.monsters[opponentsIndex].cell);
+					const uint8 resultingCell = FMCTSSearchState::CellOf((position - position * modulated).ClampAxes(0, 2));
+					state.monsters[opponentsIndex] = ChangeMonster(state.monsters[opponentsIndex], resultingCell, effect.type, modulated);
+					break;
+				}
+				case EEffect::MoveTo:
+					state.monsters[castersIndex] = ChangeMonster(state.monsters[castersIndex], targetCell, effect.type, modulated);
+					break;
+				}
+			}
+		}
+
+		static void Rescore(FMCTSSearchMonster& monster, const FMCTSSearchPlatform& platform)
+		{
+			float newScore = (
+				FGenericPlatformMath::Abs(platform.temp - monster.temp) +
+				FGenericPlatformMath::Abs(platform.hum - monster.hum) +
+				FGenericPlatformMath::Abs(platform.elev - monster.elev)
+				) / 3.0f;
+			newScore /= 0.01f * monster.def;
+			newScore = FMath::Lerp(0.0f, 1.0f, newScore);
+			newScore = FMath::Clamp(newScore, 0.0f, 1.0f) * 100.0f;
+
+			const float scoreRatio = newScore / monster.score;
+			monster.atk = monster.atk * scoreRatio;
+			monster.spd = monster.spd * scoreRatio;
+		}
+
+		FMCTSSearchState NextState(const FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random) const
+		{
+			FMCTSSearchState resultingState = state;
+			const int32 castersIndex = state.actingPlayerIndex;
+			const int32 moveIndex = move.GetMoveIndex();
+			const FGeneratedMove& generatedMove = moveIndex >= 0 ?
+				(castersIndex == 0 ? playerMoves[moveIndex] : opponentMoves[moveIndex]) :
+				systemMoves[-moveIndex - 2];
+
+			const int32 selectorIndex = move.GetSelectorIndex();
+			if (move.HasTarget() && generatedMove.selectors.IsValidIndex(selectorIndex)) {
+				TArray<uint8> targets;
+				FillTargets(generatedMove.selectors[selectorIndex], static_cast<uint8>(move.GetTargetCell()), state.monsters[castersIndex].cell, state.monsters[1 - castersIndex].cell, random, targets);
+				if (generatedMove.effectLists.IsValidIndex(selectorIndex)) {
+					for (const uint8 target : targets)
+						RunEffects(generatedMove.effectLists[selectorIndex], castersIndex, target, resultingState);
+				}
+			}
+
+			resultingState.monsters[castersIndex].ap -= move.GetCost();
+			for (FMCTSSearchMonster& monster : resultingState.monsters)
+				Rescore(monster, resultingState.platforms[monster.cell]);
+
+			if (moveIndex != 0)
+				return resultingState;
+
+			// Jumps: a sandtrap under the caster takes the whole move back, otherwise the landing platform's statuses
+			// react in the order they were added.
+			if (resultingState.platforms[resultingState.monsters[castersIndex].cell].HasStatus(EMCTSPlatformStatusTypes::Sandtrap)) {
+				resultingState = state;
+				resultingState.monsters[castersIndex].ap -= 1;
+				return resultingState;
+			}
+			const uint8 landingCell = static_cast<uint8>(move.GetTargetCell());
+			TArray<int32> reactionMoves;
+			resultingState.platforms[landingCell].ForEachStatus([&reactionMoves](EMCTSPlatformStatusTypes status) {
+				if (status == EMCTSPlatformStatusTypes::Freeze)
+					reactionMoves.Add(-2);
+				else if (status == EMCTSPlatformStatusTypes::Ignite)
+					reactionMoves.Add(-3);
+				else if (status == EMCTSPlatformStatusTypes::Flood)
+					reactionMoves.Add(-4);
+			});
+			for (const int32 reactionMove : reactionMoves)
+				resultingState = NextState(resultingState, FMCTSMoveId::Make(castersIndex, reactionMove, 0, landingCell, 0), random);
+			return resultingState;
+		}
+	};
+}
+
+using namespace MCTSBattleRulesetTests;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMCTSJournalUndoTest, "ProtoGardenBattle.MCTS.Journal.UndoRestoresExactState", TestFlags)
+
+bool FMCTSJournalUndoTest::RunTest(const FString& Parameters)
+{
+	FMCTSBattleRuleset ruleSet;
+	IngestTestMoveSets(ruleSet);
+
+	FMCTSRandom random(7);
+	FMCTSStateJournal journal;
+	FMCTSMoveList moves;
+	TArray<FMCTSSearchState> line;
+
+	for (int32 game = 0; game < 100; game++) {
+		FMCTSSearchState state = MakeStartingState();
+		line.Reset();
+
+		// Play a random line forward on the one state, keeping a copy from before each move...
+		for (int32 depth = 0; depth < 60 && !ruleSet.IsTerminalState(state); depth++) {
+			ruleSet.EnumerateMoves(state, moves);
+			const FMCTSMoveId move = moves[random.RandRange(0, moves.Num() - 1)];
+
+			FMCTSRandom nextStateRandom = random;
+			const FMCTSSearchState expected = ruleSet.NextState(state, move, nextStateRandom);
+
+			line.Add(state);
+			ruleSet.ApplyMove(state, move, random, &journal);
+			if (!TestTrue(FString::Printf(TEXT("Game %d move %d: ApplyMove matches NextState"), game, depth), IsSameState(state, expected)))
+				return false;
+		}
+
+		// ...then walk it back up, one move at a time.
+		TestEqual(TEXT("One journal entry per move"), journal.NumMoves(), line.Num());
+		while (journal.NumMoves() > 0) {
+			journal.UndoMove(state);
+			if (!TestTrue(FString::Printf(TEXT("Game %d: undoing move %d restores the state before it"), game, journal.NumMoves()), IsSameState(state, line[journal.NumMoves()])))
+				return false;
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMCTSSeededSearchTest, "ProtoGardenBattle.MCTS.Agent.SeededSearchIsReproducible", TestFlags)
+
+bool FMCTSSeededSearchTest::RunTest(const FString& Parameters)
+{
+	FMCTSBattleRuleset ruleSet;
+	IngestTestMoveSets(ruleSet);
+	IMCTSSearchRuleSet& virtualRuleSet = ruleSet;
+
+	for (int32 seed = 0; seed < 5; seed++) {
+		FMCTSBattleAgent staticAgent(300);
+		FMCTSBattleAgent sameSeedAgent(300);
+		FMCTSBattleAgent otherSeedAgent(300);
+		UMCTSAgent virtualAgent(300);
+		const int64 iterations = SearchFromStart(staticAgent, ruleSet, seed);
+		TestEqual(FString::Printf(TEXT("Seed %d: iterations"), seed), iterations, static_cast<int64>(300));
+
+		SearchFromStart(sameSeedAgent, ruleSet, seed);
+		TestTrue(FString::Printf(TEXT("Seed %d: the same seed grows the same tree again"), seed), IsSameTree(staticAgent.GetRootNode(), sameSeedAgent.GetRootNode()));
+
+		SearchFromStart(virtualAgent, virtualRuleSet, seed);
+		TestTrue(FString::Printf(TEXT("Seed %d: UMCTSAgent (virtual calls) grows the same tree as FMCTSBattleAgent"), seed), IsSameTree(staticAgent.GetRootNode(), virtualAgent.GetRootNode()));
+
+		// Otherwise the comparisons above could pass on a tree the seed doesn't reach.
+		SearchFromStart(otherSeedAgent, ruleSet, seed + 100);
+		TestFalse(FString::Printf(TEXT("Seed %d: another seed grows a different tree"), seed), IsSameTree(staticAgent.GetRootNode(), otherSeedAgent.GetRootNode()));
+
+		FMCTSBattleAgent rootParallelAgent(300);
+		FMCTSBattleAgent sameSeedRootParallelAgent(300);
+		SearchFromStart(rootParallelAgent, ruleSet, seed, 4);
+		SearchFromStart(sameSeedRootParallelAgent, ruleSet, seed, 4);
+		TestTrue(FString::Printf(TEXT("Seed %d: root-parallel search is reproducible too"), seed), IsSameTree(rootParallelAgent.GetRootNode(), sameSeedRootParallelAgent.GetRootNode()));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMCTSMoveCollapseTest, "ProtoGardenBattle.MCTS.Moves.CollapseKeepsDistinctOutcomes", TestFlags)
+
+bool FMCTSMoveCollapseTest::RunTest(const FString& Parameters)
+{
+	FMCTSBattleRuleset ruleSet;
+	IngestTestMoveSets(ruleSet);
+
+	FMCTSRandom random(20);
+	FMCTSMoveList moves;
+	int32 numEnumerated = 0;
+	int32 numKept = 0;
+
+	for (int32 game = 0; game < 40; game++) {
+		FMCTSSearchState state = MakeStartingState();
+
+		for (int32 depth = 0; depth < 40 && !ruleSet.IsTerminalState(state); depth++) {
+			ruleSet.EnumerateMoves(state, moves);
+			for (int32 moveIndex = 0; moveIndex < moves.Num(); moveIndex++) {
+				if (!TestFalse(TEXT("EnumerateMoves never lists a move twice"), moves.Find(moves[moveIndex]) != moveIndex))
+					return false;
+			}
+
+			UMCTSNode node(state);
+			node.CacheMoves(&ruleSet, true);
+			const FMCTSMoveList& kept = node.moves;
+			numEnumerated += moves.Num();
+			numKept += kept.Num();
+
+			// Where each deterministic move kept so far leads, as hashed: the collapse is as fine as FMCTSStateHasher.
+			TArray<uint64> keptOutcomes;
+			int32 keptIndex = 0;
+			for (const FMCTSMoveId move : moves) {
+				const bool bKept = keptIndex < kept.Num() && kept[keptIndex] == move;
+				keptIndex += bKept ? 1 : 0;
+
+				if (move.IsEndTurn() || ruleSet.HasRandomOutcome(state, move)) {
+					if (!TestTrue(TEXT("End turn and moves with a random outcome are always kept"), bKept))
+						return false;
+					continue;
+				}
+
+				FMCTSSearchState outcome = state;
+				FMCTSRandom unused;
+				ruleSet.ApplyMove(outcome, move, unused);
+				const uint64 outcomeHash = FMCTSStateHasher::Hash(outcome);
+				if (!TestEqual(TEXT("A deterministic move is dropped exactly when an earlier kept move leads to the same state"), bKept, !keptOutcomes.Contains(outcomeHash)))
+					return false;
+				if (bKept)
+					keptOutcomes.Add(outcomeHash);
+			}
+			if (!TestEqual(TEXT("The kept moves come in enumeration order"), keptIndex, kept.Num()))
+				return false;
+
+			ruleSet.ApplyMove(state, moves[random.RandRange(0, moves.Num() - 1)], random);
+		}
+	}
+
+	AddInfo(FString::Printf(TEXT("Kept %d of %d enumerated moves (%.1f%%)."), numKept, numEnumerated, 100.0f * numKept / FMath::Max(numEnumerated, 1)));
+	TestTrue(TEXT("Some moves on the test moveset collapse"), numKept < numEnumerated);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMCTSSolverProofTest, "ProtoGardenBattle.MCTS.Agent.ProofsMatchExhaustiveSearch", TestFlags)
+
+bool FMCTSSolverProofTest::RunTest(const FString& Parameters)
+{
+	// With and without random targets: a proof must never rest on one roll of a chance move.
+	for (int32 randomTargets = 0; randomTargets < 2; randomTargets++) {
+		FMCTSBattleRuleset ruleSet;
+		IngestTestMoveSets(ruleSet, randomTargets != 0);
+
+		int32 rootsSolved = 0;
+		int32 solved = 0;
+		int32 checked = 0;
+		int32 wrong = 0;
+		for (int32 trial = 0; trial < 20; trial++) {
+			FMCTSRandom random(trial + 100);
+			FMCTSSearchState state = MakeLastMoveState(ruleSet, random);
+			// Scores never change during play, so this settles the game: drawn, or either monster ahead.
+			state.monsters[trial % 2].score += (trial % 3) * 5.0f;
+
+			const int32 budget = 3000;
+			FMCTSBattleAgent agent(budget);
+			agent.ruleSet = &ruleSet;
+			agent.SetSeed(trial);
+			const int64 iterations = agent.RunSearch(state);
+
+			if (agent.GetRootNode()->IsSolved()) {
+				rootsSolved++;
+				TestTrue(TEXT("The search stops once the root is proven"), iterations < budget);
+			}
+			CheckProofs(ruleSet, agent.GetRootNode(), solved, checked, wrong);
+		}
+
+		AddInfo(FString::Printf(TEXT("Random targets %d: %d of 20 roots proven, %d proven nodes, %d checked by hand."), randomTargets, rootsSolved, solved, checked));
+		TestEqual(FString::Printf(TEXT("Random targets %d: proofs that disagree with exhaustive search"), randomTargets), wrong, 0);
+		TestTrue(FString::Printf(TEXT("Random targets %d: some proofs were checked"), randomTargets), checked > 0 && rootsSolved > 0);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMCTSWinPerspectiveTest, "ProtoGardenBattle.MCTS.Agent.WinsAreForThePlayerToMove", TestFlags)
+
+bool FMCTSWinPerspectiveTest::RunTest(const FString& Parameters)
+{
+	FMCTSBattleRuleset ruleSet;
+	IngestTestMoveSets(ruleSet);
+
+	// Scores never change during play, so whoever starts ahead wins every game, whoever moves last.
+	for (int32 winner = 0; winner < 2; winner++) {
+		// Playouts one at a time and as a parallel batch, then with the endgame solver standing in near the end.
+		for (int32 mode = 0; mode < 3; mode++) {
+			FMCTSBattleAgent agent(500);
+			agent.ruleSet = &ruleSet;
+			agent.SetSeed(winner);
+			agent.SetParallelPlayouts(mode == 1);
+			agent.SetEndgameSolver(mode == 2 ? 1 : 0);
+			const FMCTSRandom random(winner);
+			FMCTSRandom lastMoveRandom = random;
+			FMCTSSearchState searchState = mode == 2 ? MakeLastMoveState(ruleSet, lastMoveRandom) : MakeStartingState();
+			searchState.monsters[winner].score += 10.0f;
+			agent.RunSearch(searchState);
+
+			int32 checked = 0;
+			int32 wrong = 0;
+			CheckWinsForWinner(agent.GetRootNode(), winner, checked, wrong);
+			TestTrue(FString::Printf(TEXT("Winner %d, mode %d: nodes checked"), winner, mode), checked > 0);
+			TestEqual(FString::Printf(TEXT("Winner %d, mode %d: nodes whose wins aren't for the player to move there"), winner, mode), wrong, 0);
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMCTSMoveGainsTest, "ProtoGardenBattle.MCTS.Playouts.GainsEstimateMatchesNextState", TestFlags)
+
+bool FMCTSMoveGainsTest::RunTest(const FString& Parameters)
+{
+	FMCTSBattleRuleset ruleSet;
+	IngestTestMoveSets(ruleSet);
+
+	int32 checked = 0;
+	int32 moved = 0;
+	FMCTSMoveList moves;
+	for (int32 trial = 0; trial < 200; trial++) {
+		FMCTSRandom random(trial + 9000);
+		FMCTSSearchState state = MakeStartingState();
+		for (int32 depth = 0; depth < trial % 30 && !ruleSet.IsTerminalState(state); depth++) {
+			ruleSet.EnumerateMoves(state, moves);
+			ruleSet.ApplyMove(state, moves[random.RandRange(0, moves.Num() - 1)], random);
+		}
+		if (ruleSet.IsTerminalState(state))
+			continue;
+
+		const int32 playerIndex = state.actingPlayerIndex;
+		ruleSet.EnumerateMoves(state, moves);
+		for (const FMCTSMoveId move : moves) {
+			// The estimate leaves out jumps' reactions, and a random outcome can't be compared one roll against another.
+			if (move.IsEndTurn() || move.GetMoveIndex() == 0 || ruleSet.HasRandomOutcome(state, move))
+				continue;
+
+			FMCTSMoveList single;
+			single.Add(move);
+			float estimate = 0.0f;
+			FMCTSRandom estimateRandom(trial);
+			ruleSet.EstimateMoveGains(state, single, estimateRandom, &estimate);
+
+			FMCTSRandom moveRandom(trial);
+			const FMCTSSearchState after = ruleSet.NextState(state, move, moveRandom);
+			const float actual = ruleSet.PlatformLead(after, playerIndex) - ruleSet.PlatformLead(state, playerIndex);
+
+			checked++;
+			moved += actual != 0.0f ? 1 : 0;
+			TestEqual(FString::Printf(TEXT("Trial %d, move %u: estimated gain against the PlatformLead change"), trial, move.packed), estimate, actual, 1e-3f);
+		}
+	}
+
+	AddInfo(FString::Printf(TEXT("Checked %d moves, %d of which changed PlatformLead."), checked, moved));
+	TestTrue(TEXT("Some moves changed PlatformLead"), moved > 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMCTSAmafTest, "ProtoGardenBattle.MCTS.Agent.AmafCountsAreConsistent", TestFlags)
+
+bool FMCTSAmafTest::RunTest(const FString& Parameters)
+{
+	FMCTSBattleRuleset ruleSet;
+	IngestTestMoveSets(ruleSet);
+
+	// Scores never change during play, so every playout is the winner's, and AMAF wins can be checked exactly.
+	for (int32 winner = 0; winner < 2; winner++) {
+		for (int32 mode = 0; mode < 3; mode++) {
+			const bool bRave = mode != 0;
+			FMCTSBattleAgent agent(500);
+			agent.ruleSet = &ruleSet;
+			agent.SetSeed(winner);
+			agent.SetRave(bRave ? 300 : 0);
+			if (mode == 2)
+				agent.SetParallelism(EMCTSParallelMode::Tree, 4);
+			FMCTSSearchState state = MakeStartingState();
+			state.monsters[winner].score += 10.0f;
+			agent.RunSearch(state);
+
+			const UMCTSNode* root = agent.GetRootNode();
+			int32 checked = 0;
+			int32 wrong = 0;
+			CheckAmafForWinner(root, winner, bRave, checked, wrong);
+			TestEqual(FString::Printf(TEXT("Winner %d, mode %d: AMAF slots out of line"), winner, mode), wrong, 0);
+			if (!bRave)
+				continue;
+
+			TestTrue(FString::Printf(TEXT("Winner %d, mode %d: AMAF slots counted"), winner, mode), checked > 0);
+			// An expanded child's own playouts all played its move, so they count for it at the root.
+			for (int32 childIndex = 0; childIndex < root->NumExpandedChildren(); childIndex++)
+				TestTrue(FString::Printf(TEXT("Winner %d, mode %d: root child %d has AMAF visits"), winner, mode, childIndex), root->childStats.amafVisits[childIndex].load() > 0);
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMCTSEffectProgramTest, "ProtoGardenBattle.MCTS.Effects.CompiledMatchesGeneratedEffects", TestFlags)
+
+bool FMCTSEffectProgramTest::RunTest(const FString& Parameters)
+{
+	// The shared test moveset, then one that reaches every selector and every way a gate or store can sit in a list.
+	for (int32 moveSet = 0; moveSet < 2; moveSet++) {
+		FReferenceRules reference;
+		reference.playerMoves = moveSet == 0 ? MakeMoveList(false) : MakeEffectProgramMoveList(false);
+		reference.opponentMoves = moveSet == 0 ? MakeMoveList(true) : MakeEffectProgramMoveList(true);
+		reference.systemMoves = MakeSystemMoveList();
+		FMCTSBattleRuleset ruleSet;
+		ruleSet.IngestMoveSets(reference.playerMoves, reference.opponentMoves, reference.systemMoves);
+
+		int32 checked = 0;
+		FMCTSMoveList moves;
+		for (int32 game = 0; game < 40; game++) {
+			FMCTSRandom random(game + 500);
+			FMCTSSearchState state = MakeStartingState();
+			for (int32 depth = 0; depth < 40 && !ruleSet.IsTerminalState(state); depth++) {
+				// Every move of the player to move, and every system move, on every selector and every target cell.
+				const int32 castersIndex = state.actingPlayerIndex;
+				const TArray<FGeneratedMove>& generatedMoves = castersIndex == 0 ? reference.playerMoves : reference.opponentMoves;
+				for (int32 moveIndex = -reference.systemMoves.Num() - 1; moveIndex < generatedMoves.Num(); moveIndex++) {
+					if (moveIndex == -1)
+						continue;
+					const FGeneratedMove& generatedMove = moveIndex >= 0 ? generatedMoves[moveIndex] : reference.systemMoves[-moveIndex - 2];
+					for (int32 selectorIndex = 0; selectorIndex < generatedMove.selectors.Num(); selectorIndex++) {
+						for (uint8 cell = 0; cell < FMCTSSearchState::NumPlatforms; cell++) {
+							const FMCTSMoveId move = FMCTSMoveId::Make(castersIndex, moveIndex, selectorIndex, cell, generatedMove.cost);
+							FMCTSRandom compiledRandom(checked);
+							FMCTSRandom referenceRandom(checked);
+							const FMCTSSearchState compiled = ruleSet.NextState(state, move, compiledRandom);
+							const FMCTSSearchState expected = reference.NextState(state, move, referenceRandom);
+							checked++;
+							if (!TestTrue(FString::Printf(TEXT("Move set %d, game %d, depth %d: move %d, selector %d onto cell %d runs as the generated effects do"), moveSet, game, depth, moveIndex, selectorIndex, cell), IsSameState(compiled, expected)))
+								return false;
+							TestEqual(TEXT("The compiled move draws the same random numbers"), compiledRandom.Next64(), referenceRandom.Next64());
+						}
+					}
+				}
+
+				ruleSet.EnumerateMoves(state, moves);
+				ruleSet.ApplyMove(state, moves[random.RandRange(0, moves.Num() - 1)], random);
+			}
+		}
+		AddInfo(FString::Printf(TEXT("Move set %d: %d moves checked."), moveSet, checked));
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -4,18 +4,144 @@
 #include "MCTSAgent.h"
 #include "MovesetGenerator.h"
 
-class PROTOGARDENBATTLE_API FMCTSBattleRuleset : public IMCTSRuleSet
+// What IngestMoveSets compiles a Gate* or Store* effect into when it can fold it into the effect right after it.
+enum class EMCTSEffectPrefix : uint8 {
+    None,
+    Gate,  // Skip this effect if the gate holds.
+    Store  // Replace this effect's power with the stored platform condition.
+};
+
+// One step of a compiled effect list. Powers are already divided by 100.
+struct FMCTSEffectInstruction {
+    EGeneratedMoveEffectTypes type;
+    EMCTSEffectPrefix prefix;
+    uint8 prefixCondition; // Platform condition the prefix reads: 0 temp, 1 hum, 2 elev.
+    float power;
+    float prefixPower;
+};
+
+// A move's effect list for one selector, as a slice of FMCTSBattleRuleset::program.
+struct FMCTSCompiledEffectList {
+    EGeneratedMoveTargetSelectorTypes selector;
+    int32 firstInstruction;
+    int32 numInstructions;
+    bool bMovesMonsters = false; // Has a MoveTo or PullPush, so it can change who stands where.
+};
+
+// An FGeneratedMove with everything NextState and EnumerateMoves need, as slices of the ruleset's flat arrays.
+struct FMCTSCompiledMove {
+    int32 firstList; // Into FMCTSBattleRuleset::effectLists, one per selector.
+    int32 numLists;
+    int32 cost;
+};
+
+// Short list of grid cells, kept on the stack. Enough for every target a single move can fill in.
+struct FMCTSCellList
+{
+    static constexpr int MaxCells = 16;
+
+    uint8 cells[MaxCells];
+    int num = 0;
+    uint16 mask = 0; // Board of every cell in the list, so AddUnique is a bit test.
+
+    void Add(uint8 cell)
+    {
+        if (num < MaxCells) {
+            cells[num++] = cell;
+            mask |= FMCTSSearchState::CellBit(cell);
+        }
+    }
+
+    void AddUnique(uint8 cell)
+    {
+        if (!(mask & FMCTSSearchState::CellBit(cell)))
+            Add(cell);
+    }
+};
+
+// A platform status reaction to a jump (slip, stamp or splash), as compiled from systemMoveList.
+// The targets are worked out for every caster/landing cell up front, so a jump runs the effects straight away
+// instead of going back through ApplyMoveInPlace as a system move.
+struct FMCTSCompiledReaction {
+    int32 effectList = INDEX_NONE; // Into FMCTSBattleRuleset::effectLists. INDEX_NONE if the system move has no effects.
+    TArray<FMCTSCellList> targets; // [caster cell * 9 + landing cell]. Empty when the selector is random or reads the opponent's cell.
+    bool bRandomTargets = false;
+};
+
+// Native battle rules, run directly on FMCTSSearchState so the search never allocates.
+// Final so FMCTSBattleAgent's calls into it are direct (and inlinable) rather than virtual.
+class PROTOGARDENBATTLE_API FMCTSBattleRuleset final : public IMCTSSearchRuleSet
 {
 public:
     void IngestMoveSets(TArray<FGeneratedMove> playerMoveList, TArray<FGeneratedMove> opponentMoveList, TArray<FGeneratedMove> systemMoveList);
 
-    FMCTSGameState NextState(const FMCTSGameState& state, const FMCTSMove& move);
-    TArray<FMCTSMove> EnumerateMoves(const FMCTSGameState& state);
-    bool IsTerminalState(const FMCTSGameState& state);
-    bool EvaluateTerminalState(const FMCTSGameState& state, int _playerIndex);
+    FMCTSSearchState NextState(const FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random);
+    void ApplyMove(FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random, FMCTSStateJournal* journal = nullptr);
+    void EnumerateMoves(const FMCTSSearchState& state, FMCTSMoveList& outMoves);
+    bool IsTerminalState(const FMCTSSearchState& state);
+    bool EvaluateTerminalState(const FMCTSSearchState& state, int _playerIndex);
+    float EvaluateState(const FMCTSSearchState& state, int _playerIndex);
+    bool HasRandomOutcome(const FMCTSSearchState& state, FMCTSMoveId move);
+    int32 TurnsRemaining(const FMCTSSearchState& state);
+
+    // How much better the player's platform suits it than the opponent's does theirs (PlatformScore, 0-100 each).
+    float PlatformLead(const FMCTSSearchState& state, int _playerIndex) const;
+    // Roughly how much each move would raise PlatformLead for the player making it, without applying any of them.
+    void EstimateMoveGains(const FMCTSSearchState& state, const FMCTSMoveList& moves, FMCTSRandom& random, float* outGains) const;
+
+    // Off sends jump reactions back through ApplyMoveInPlace as system moves, the way they used to run. Same results
+    // either way, it's only there to benchmark against.
+    void SetInlineReactions(bool _bInlineReactions) { bInlineReactions = _bInlineReactions; }
 private:
-    void ApplyPlatformStatusTriggersToState(const int castersIndex, const FMCTSMove& move, FMCTSGameState& inputState, bool& overrideJump);
-    TArray<FGeneratedMove> playerMoveList;
-    TArray<FGeneratedMove> opponentMoveList;
-    TArray<FGeneratedMove> systemMoveList;
+    void ApplyMoveInPlace(FMCTSSearchState& state, FMCTSMoveId move, FMCTSRandom& random, FMCTSStateJournal* journal);
+    void ApplyPlatformStatusTriggersToState(const int castersIndex, FMCTSMoveId move, FMCTSSearchState& inputState, FMCTSRandom& random, FMCTSStateJournal* journal, bool& overrideJump);
+    void CompileMoveList(const TArray<FGeneratedMove>& moveList, TArray<FMCTSCompiledMove>& outMoves);
+    void CompileEffectList(const TArray<FGeneratedEffect>& effects);
+    void CompileReactions();
+    void ApplyReaction(const FMCTSCompiledReaction& reaction, const int castersIndex, const uint8 landingCell, FMCTSSearchState& state, FMCTSRandom& random, FMCTSStateJournal* journal) const;
+    void RunEffectList(const FMCTSCompiledEffectList& effectList, const int castersIndex, const uint8 currentTargetCell, FMCTSSearchState& resultingState) const;
+
+    // Movesets as compiled by IngestMoveSets, so NextState never copies or re-reads the FGeneratedMove structs.
+    TArray<FMCTSCompiledMove> playerMoveList;
+    TArray<FMCTSCompiledMove> opponentMoveList;
+    TArray<FMCTSCompiledMove> systemMoveList;
+    TArray<FMCTSCompiledEffectList> effectLists;
+    TArray<FMCTSEffectInstruction> program; // Every effect list's instructions, back to back.
+    TArray<FMCTSCompiledReaction> reactions; // Slip, stamp and splash: the first three system moves.
+    bool bInlineReactions = true;
 };
+
+// Epsilon-greedy playouts for the battle rules: Epsilon of the time a random move, otherwise the one with the best
+// EstimateMoveGains (ties broken at random). Each playout step costs a pass of EstimateMoveGains, not a NextState per move.
+struct FMCTSBattleGreedyPolicy : public FMCTSDefaultPolicy {
+    static constexpr float Epsilon = 0.25f;
+
+    static int32 ChoosePlayoutMove(const FMCTSBattleRuleset& ruleSet, const FMCTSSearchState& state, const FMCTSMoveList& moves, FMCTSRandom& random) {
+        if (random.FRand() < Epsilon)
+            return random.RandRange(0, moves.Num() - 1);
+
+        TArray<float, TInlineAllocator<64>> gains;
+        gains.SetNumUninitialized(moves.Num());
+        ruleSet.EstimateMoveGains(state, moves, random, gains.GetData());
+
+        int32 bestMoveIndex = 0;
+        float bestGain = -std::numeric_limits<float>::infinity();
+        int32 ties = 0;
+        for (int32 moveIndex = 0; moveIndex < moves.Num(); moveIndex++) {
+            const float gain = gains[moveIndex];
+            if (gain > bestGain) {
+                bestGain = gain;
+                bestMoveIndex = moveIndex;
+                ties = 1;
+            }
+            else if (gain == bestGain && random.RandRange(0, ties++) == 0) {
+                bestMoveIndex = moveIndex;
+            }
+        }
+        return bestMoveIndex;
+    }
+};
+
+// Agent bound to the native rules at compile time.
+typedef TMCTSAgent<FMCTSBattleRuleset> FMCTSBattleAgent;
+typedef TMCTSAgent<FMCTSBattleRuleset, FMCTSBattleGreedyPolicy> FMCTSBattleGreedyAgent;
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MCTSAgent.h"
+#include "MCTSBattleRuleset.h"
+
+// Timing harness for the native search path. Results go to the log.
+class PROTOGARDENBATTLE_API FMCTSBenchmark
+{
+public:
+    // Runs one search per thread count (1, 2, 4, 8, 16) in root- and tree-parallel mode and logs iterations/sec.
+    static void ThreadScaling(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int iterationBudget);
+    // Runs the same single-threaded search through UMCTSAgent (virtual calls) and FMCTSBattleAgent (direct calls).
+    static void Dispatch(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int iterationBudget);
+    // Times NextState on jumps onto platforms that set off slip, stamp and splash, with the reactions applied inline and
+    // as system moves, against the same jumps onto plain platforms.
+    static void JumpReactions(const FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int jumps);
+    // Runs searches with playouts cut off after 4, 8 and 16 moves and with full playouts, logging iterations/sec, how
+    // often each picks the move a full-playout search with 4x the budget picks, and the wins and final PlatformLead each
+    // reaches playing whole games against that search. Also times EvaluateState against a full playout.
+    static void PlayoutCutoff(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int iterationBudget);
+    // Times random and epsilon-greedy playouts, then plays greedy against random from each side and logs the greedy
+    // side's win rate and final PlatformLead.
+    static void PlayoutPolicy(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int playouts);
+    // Runs searches of 100, 500 and 2000 iterations with and without RAVE, logging iterations/sec and how often each
+    // picks the move a plain search of 20000 iterations picks.
+    static void Rave(FMCTSBattleRuleset& ruleSet, const FMCTSGameState& startingState, int raveEquivalence);
+};
@@ -9,6 +9,8 @@
 #include "AIController.h"
 #include "Engine/World.h"
 #include "Async/AsyncWork.h"
+#include "Async/Async.h"
+#include <atomic>
 #include "MCTSPlayerController.generated.h"
 
 // delegate for whatever node comes after the MCTS finishes.
@@ -22,6 +24,10 @@ class PROTOGARDENBATTLE_API AMCTSPlayerController : public AAIController, public
 {
     GENERATED_BODY()
 public:
+    AMCTSPlayerController();
+
+    virtual void Tick(float DeltaSeconds) override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
     
     UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "MCTS")
         FMCTSGameState NextState(const FMCTSGameState& state, const FMCTSMove& move);
@@ -35,12 +41,113 @@ public:
 
     UFUNCTION(BlueprintCallable, Category = "MCTS")
         void SetupBattleMovesets(TArray<FGeneratedMove> playerMoveList, TArray<FGeneratedMove> opponentMoveList, TArray<FGeneratedMove> systemMoveList);
+    // With timeBudgetMs > 0 each move is searched for that long, with iterationBudget as an optional cap (<= 0 for none).
     UFUNCTION(BlueprintCallable, Category = "MCTS", meta = (BlueprintThreadSafe))
-        void DecideNextMove(FMCTSDelegate Out, const FMCTSGameState& inputState, const int playerIndex, const int iterationBudget);
+        void DecideNextMove(FMCTSDelegate Out, const FMCTSGameState& inputState, const int playerIndex, const int iterationBudget, const float timeBudgetMs = 0.0f);
+    UFUNCTION(BlueprintCallable, Category = "MCTS")
+        void DecideNextMoveSync(FMCTSDelegate Out, const FMCTSGameState& inputState, const int playerIndex, const int iterationBudget, const float timeBudgetMs = 0.0f);
+    // Like DecideNextMoveSync, but the search runs on the game thread a slice at a time (sliceMicroseconds per tick),
+    // so it never hitches a frame. The moves go out through Out once the budget is spent.
+    UFUNCTION(BlueprintCallable, Category = "MCTS")
+        void DecideNextMoveSliced(FMCTSDelegate Out, const FMCTSGameState& inputState, const int playerIndex, const int iterationBudget, const float sliceMicroseconds = 2000.0f, const float timeBudgetMs = 0.0f);
+
+    // Tells the agent which move the opponent actually played, so its search carries on from the matching subtree.
+    // Optional: the next DecideNextMove finds the subtree from its input state anyway, this just keeps pondering on track.
+    UFUNCTION(BlueprintCallable, Category = "MCTS")
+        void NotifyOpponentMove(const FMCTSMove& move);
+    // Throws away the saved tree, e.g. when a new battle starts.
     UFUNCTION(BlueprintCallable, Category = "MCTS")
-        void DecideNextMoveSync(FMCTSDelegate Out, const FMCTSGameState& inputState, const int playerIndex, const int iterationBudget);
+        void ResetAgent();
+
+    // Logs root- and tree-parallel iterations/sec for 1 to 16 threads on the native ruleset.
+    UFUNCTION(BlueprintCallable, Category = "MCTS|Benchmark")
+        void BenchmarkThreadScaling(const FMCTSGameState& inputState, const int iterationBudget);
+    // Logs iterations/sec for the native ruleset searched through the virtual interface and through FMCTSBattleAgent.
+    UFUNCTION(BlueprintCallable, Category = "MCTS|Benchmark")
+        void BenchmarkDispatch(const FMCTSGameState& inputState, const int iterationBudget);
+    // Logs NextState cost for jumps that set off platform status reactions, inline and as system moves.
+    UFUNCTION(BlueprintCallable, Category = "MCTS|Benchmark")
+        void BenchmarkJumpReactions(const FMCTSGameState& inputState, const int jumps = 100000);
+    // Logs iterations/sec and decision agreement for playouts cut off at a few depths against full playouts.
+    UFUNCTION(BlueprintCallable, Category = "MCTS|Benchmark")
+        void BenchmarkPlayoutCutoff(const FMCTSGameState& inputState, const int iterationBudget = 1000);
+    // Logs playouts/sec for random and greedy playouts, and how greedy playouts do against random ones.
+    UFUNCTION(BlueprintCallable, Category = "MCTS|Benchmark")
+        void BenchmarkPlayoutPolicy(const FMCTSGameState& inputState, const int playouts = 10000);
+    // Logs how often searches of 100, 500 and 2000 iterations pick a long reference search's move, with and without RAVE.
+    UFUNCTION(BlueprintCallable, Category = "MCTS|Benchmark")
+        void BenchmarkRave(const FMCTSGameState& inputState, const int raveEquivalence = 500);
+
+    // Threads used by DecideNextMove. Only used with the native ruleset.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        int searchThreads = 1;
+    // When set, all search threads share one tree (virtual loss) instead of growing one tree each.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        bool sharedTreeSearch = false;
+    // Runs the playouts for each expanded node as a parallel batch. Only used with the native ruleset.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        bool parallelPlayouts = false;
+    // Expands one move per distinct resulting state, skipping moves that do the same as an earlier one. Only used with the native ruleset.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        bool collapseEquivalentMoves = false;
+    // Playouts mostly take the move that best improves how well each monster's platform suits it, instead of a random
+    // one. Stronger playouts, fewer of them per second. Only used with the native ruleset.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        bool greedyPlayouts = false;
+    // Playouts stop after this many moves and are scored by the ruleset's evaluator instead. 0 plays every game out.
+    // Only used with the native ruleset.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        int playoutCutoff = 0;
+    // RAVE equivalence: blends in all-moves-as-first statistics, which matter most when the iteration budget is small.
+    // Roughly the visit count at which a child's own results count as much as its AMAF ones. 0 leaves RAVE off.
+    // Only used with the native ruleset.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        int raveEquivalence = 0;
+    // Nodes this many turns or fewer from the end are searched to the end exactly instead of played out. 0 leaves it
+    // to playouts. Only used with the native ruleset.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        int endgameSolverTurns = 0;
+    // log2 of the transposition table's entry count (e.g. 16 for 65536 entries). 0 leaves it off.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        int transpositionTableSizeLog2 = 0;
+    // Seeds the search's random streams, so a given state and iteration budget always get the same decision
+    // (handy for perf regression runs). 0 seeds from the clock.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        int searchSeed = 0;
+    // Keeps searching on a background thread between our decisions, which ties up a worker for the whole of the
+    // opponent's turn. Only used with the native ruleset.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "MCTS")
+        bool ponderDuringOpponentTurn = false;
 
 protected:
     FMCTSBattleRuleset battleRuleSet;
+    // Searches the Blueprint events above until SetupBattleMovesets switches to battleRuleSet.
+    FMCTSRuleSetAdapter blueprintRuleSet;
     bool useBlueprint = true;
+
+    // Creates the agent on first use. The thread/table settings above are read then, so call ResetAgent after changing them.
+    IMCTSAgent& GetAgent();
+    template<typename TBattleAgent>
+    TUniquePtr<IMCTSAgent> MakeBattleAgent();
+    void StartPondering();
+    void StopPondering();
+
+    // Kept for the whole battle so each decision starts from the subtree the last one left behind.
+    // A UMCTSAgent on the Blueprint ruleset, or an FMCTSBattleAgent (FMCTSBattleGreedyAgent) once the native one is set up.
+    TUniquePtr<IMCTSAgent> agent;
+    // Held by whoever is using the agent (a decision or the ponder task).
+    FCriticalSection agentLock;
+    // Guards ponderTask, which is started and stopped from both the game thread and decision tasks.
+    FCriticalSection ponderLock;
+    TFuture<void> ponderTask;
+    std::atomic<bool> stopPondering{ false };
+    // DecideNextMove tasks still running, and set once EndPlay starts waiting for them (no pondering after that).
+    std::atomic<int32> decisionsInFlight{ 0 };
+    std::atomic<bool> shuttingDown{ false };
+
+    // In-flight DecideNextMoveSliced search, advanced from Tick.
+    bool slicedSearchActive = false;
+    FMCTSDelegate slicedOut;
+    int slicedPlayerIndex = 0;
+    float slicedMicroseconds = 0.0f;
 };
\ No newline at end of file